@@ -23,6 +23,13 @@
  #include <sqlite3.h>
  #include <mutex>
  #include <memory>
+ #include <atomic>
+ #include <functional>
+ #include <list>
+ #include <set>
+ #include <string>
+ #include <vector>
+ #include <unordered_map>
 
  namespace Udjat {
 
@@ -30,24 +37,192 @@
 
 		class Statement;
 
+		/// @brief Query result, values as text.
+		struct Result {
+			std::vector<std::vector<std::string>> rows;
+
+			/// @brief Approximate memory used by the result.
+			size_t size = 0;
+		};
+
 		/// @brief SQLite database.
-		class UDJAT_API Database {
+		class UDJAT_API Database : public std::enable_shared_from_this<Database> {
 		private:
 			friend class Statement;
+			friend class Replica;
 
 			sqlite3 *db = NULL;
 			std::mutex guard;
 
+			/// @brief Read only connection for reports, created on demand.
+			std::shared_ptr<Database> read_connection;
+
+			/// @brief Extensions applied to every connection.
+			std::list<std::function<void(sqlite3 *db)>> extensions;
+
+			/// @brief Held by an open transaction, other threads wait for it to finish.
+			std::recursive_mutex transaction;
+
 			void check(int rc);
 
+			/// @brief Register the SQL functions (url_host, url_scheme, url_path, payload_hash).
+			static void functions(sqlite3 *db);
+
+			/// @brief Table change listener.
+			struct Listener {
+				const void *id;
+				std::string table;
+				std::function<void(const char *table)> call;
+			};
+
+			struct {
+				std::mutex guard;
+				std::list<Listener> listeners;
+
+				/// @brief Tables changed by the open transaction (only touched by hooks, under db guard).
+				std::set<std::string> changed;
+
+				/// @brief Tables changed by committed transactions, waiting for notification.
+				std::set<std::string> committed;
+
+				/// @brief Set by the commit hook, avoids locking when nothing changed.
+				std::atomic<bool> pending{false};
+			} changes;
+
+			/// @brief Result cache, keyed by SQL with bound parameters.
+			struct {
+				std::mutex guard;
+
+				/// @brief Maximum memory used by cached results, 0 disables the cache.
+				/// @details Atomic, it's checked without the guard before every query.
+				std::atomic<size_t> limit{0};
+				size_t used = 0;
+
+				/// @brief Incremented on every invalidation.
+				uint64_t epoch = 0;
+
+				/// @brief Epoch of the last invalidation by table.
+				std::unordered_map<std::string,uint64_t> versions;
+
+				struct Entry {
+					std::string key;
+					std::shared_ptr<const Result> result;
+					std::vector<std::string> tables;
+				};
+
+				/// @brief Most recently used first.
+				std::list<Entry> entries;
+				std::unordered_map<std::string,std::list<Entry>::iterator> index;
+
+				/// @brief Tables checked for caching, false for the ones changed without the update hook.
+				std::unordered_map<std::string,bool> tables;
+
+			} results;
+
+			/// @brief Check if results reading tables can be cached.
+			/// @details Virtual, internal and WITHOUT ROWID tables change without calling the update hook.
+			bool cacheable(const std::vector<std::string> &tables);
+
+			/// @brief Get cached result.
+			std::shared_ptr<const Result> cached(const std::string &key);
+
+			/// @brief Store result, unless one of the tables changed since epoch.
+			void cache(const std::string &key, std::shared_ptr<const Result> result, const std::vector<std::string> &tables, uint64_t epoch);
+
+			/// @brief Current cache epoch.
+			uint64_t epoch();
+
+			/// @brief Drop cached results reading table.
+			void invalidate(const std::string &table);
+
+			/// @brief Set by the authorizer on a drop statement (under guard).
+			bool dropping = false;
+
+			/// @brief Connection authorizer, deletes are made row by row.
+			/// @details The truncate optimization of 'delete from table' skips the update hook.
+			static int authorizer(void *database, int action, const char *arg1, const char *arg2, const char *dbname, const char *trigger);
+
+			static void update_hook(void *database, int operation, const char *dbname, const char *table, sqlite3_int64 rowid);
+			static int commit_hook(void *database);
+			static void rollback_hook(void *database);
+
+			/// @brief Notify listeners of committed changes, must be called without the db guard.
+			void notify();
+
 		public:
-			Database(const char *dbname);
+			Database(const char *dbname, bool readonly = false);
 			~Database();
 
+			/// @brief Register extension (functions, virtual tables) on this and derived connections.
+			/// @param method Called with the connection handle, throw on error.
+			void extend(const std::function<void(sqlite3 *db)> &method);
+
+			/// @brief Get a read only connection to the same database.
+			/// @details The database is switched to WAL mode so readers don't block the writer.
+			///          In-memory databases can't be shared, the same connection is returned.
+			std::shared_ptr<Database> reader();
+
+			/// @brief Stream a read only query to a report.
+			/// @details The statement is checked with an authorizer and sqlite3_stmt_readonly,
+			///          rows are pushed to the report as they are read.
+			/// @param sql The query.
+			/// @param report The report to fill.
+			/// @param max_rows Maximum number of rows, 0 for no limit.
+			/// @param max_time Maximum time in seconds, 0 for no limit.
+			/// @param args Values for the query parameters.
+			/// @param header When false the column names are not sent, the rows are appended to the report.
+			/// @return Number of rows sent.
+			size_t report(const char *sql, Udjat::Report &report, size_t max_rows = 0, time_t max_time = 0, const std::vector<std::string> &args = std::vector<std::string>(), bool header = true);
+
+			/// @brief Get the database file name, empty for in-memory databases.
+			const char * filename() const;
+
 			void exec(const char *sql);
 
 			sqlite3_stmt * prepare(const char *sql);
 
+			/// @brief Enable result cache.
+			/// @param limit Maximum memory used by cached results, 0 to disable.
+			void cache(size_t limit);
+
+			/// @brief Run read query, using the result cache when enabled.
+			/// @details Results are invalidated when a table they read is changed
+			///          through this connection.
+			std::shared_ptr<const Result> fetch(const char *sql);
+
+			/// @brief Insert table change listener.
+			/// @param id Listener identifier, used to remove it.
+			/// @param table The table name.
+			/// @param call Called after commit with the changed table, multiple changes are coalesced.
+			/// @details Changes are tracked by the update hook, SQLite doesn't call it for
+			///          WITHOUT ROWID tables; listening to one throws instead of never notifying.
+			void insert(const void *id, const char *table, const std::function<void(const char *table)> &call);
+
+			/// @brief Remove all listeners with id.
+			void remove(const void *id);
+
+			/// @brief Scoped transaction, rolled back if not committed.
+			/// @details The connection is shared, statements from other threads wait
+			///          until the transaction is finished instead of joining it.
+			///          Inside another transaction of the same thread it's a savepoint.
+			class UDJAT_API Transaction {
+			private:
+				/// @brief Keeps the database open until the transaction ends.
+				std::shared_ptr<Database> owner;
+				Database &database;
+				bool active = true;
+				bool nested = false;
+
+			public:
+				Transaction(Database &database);
+				Transaction(std::shared_ptr<Database> database);
+
+				~Transaction();
+
+				void commit();
+
+			};
+
 		};
 
 	}
@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/sqlite/database.h>
+ #include <memory>
+ #include <mutex>
+ #include <thread>
+ #include <condition_variable>
+ #include <string>
+ #include <list>
+ #include <map>
+ #include <unordered_map>
+ #include <functional>
+
+ namespace Udjat {
+
+	namespace SQLite {
+
+		/// @brief Persistent key-value store on a namespace of the 'kv' table.
+		/// @details Reads go through an in-memory LRU cache; with Batched durability
+		///          writes are kept in memory and flushed in one transaction per batch.
+		class UDJAT_API KeyValue {
+		public:
+
+			enum Durability : uint8_t {
+				Immediate,	///< @brief Write on every put or remove.
+				Batched		///< @brief Write behind, flushed by size, by a background thread on age, or by flush().
+			};
+
+		private:
+			std::shared_ptr<Database> database;
+			std::mutex guard;
+
+			/// @brief The namespace.
+			std::string ns;
+
+			Durability durability;
+
+			struct {
+				size_t max = 1024;
+				std::list<std::pair<std::string,std::string>> entries;
+				std::unordered_map<std::string,std::list<std::pair<std::string,std::string>>::iterator> index;
+			} cache;
+
+			/// @brief Keys being read from the database by get(), with the number of readers.
+			/// @details A put or remove while reading marks the key stale, the value read is not cached.
+			struct Reading {
+				size_t readers = 0;
+				bool stale = false;
+			};
+			std::unordered_map<std::string,Reading> reading;
+
+			struct Write {
+				bool removed;
+				std::string value;
+			};
+
+			struct {
+				size_t max = 128;			///< @brief Flush when this number of writes is pending.
+				time_t delay = 5;			///< @brief Flush when the oldest write has this age.
+				time_t since = 0;
+				std::map<std::string,Write> writes;
+			} pending;
+
+			/// @brief Held by flush(), the batches are written in order.
+			std::mutex flushing;
+
+			/// @brief Batched durability, flushes the pending writes when the oldest one reaches the delay.
+			std::thread *thread = nullptr;
+			std::condition_variable wakeup;
+			bool enabled = true;
+
+			void cache_put(const std::string &key, const std::string &value);
+
+			/// @brief Drop key from the read cache, must be called with the guard.
+			void uncache(const std::string &key);
+
+			/// @brief Mark key stale for the running get() calls, must be called with the guard.
+			void changed(const std::string &key);
+
+			void write(const std::string &key, const Write &write);
+
+		public:
+			KeyValue(std::shared_ptr<Database> db, const char *ns, Durability durability = Batched);
+			~KeyValue();
+
+			/// @brief Set read cache size, in entries.
+			void cache_size(size_t entries);
+
+			/// @brief Set write-behind limits.
+			/// @param writes Flush when this number of writes is pending.
+			/// @param delay Flush when the oldest pending write has this age, in seconds.
+			void batch(size_t writes, time_t delay);
+
+			/// @brief Get value.
+			/// @return false if the key was not found.
+			bool get(const std::string &key, std::string &value);
+
+			void put(const std::string &key, const std::string &value);
+
+			void remove(const std::string &key);
+
+			/// @brief Enumerate keys starting with prefix, in key order.
+			/// @param call Called for each key, return false to stop.
+			void scan(const std::string &prefix, const std::function<bool(const std::string &key, const std::string &value)> &call);
+
+			/// @brief Write pending changes in one transaction.
+			void flush();
+
+		};
+
+	}
+
+ }
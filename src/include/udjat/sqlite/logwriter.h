@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/sqlite/database.h>
+ #include <memory>
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <string>
+ #include <vector>
+ #include <functional>
+
+ namespace Udjat {
+
+	namespace SQLite {
+
+		/// @brief Log records on the 'log' table, written in batches by a background thread.
+		/// @details The message text is indexed with FTS5 when available.
+		class UDJAT_API LogWriter {
+		private:
+			std::shared_ptr<Database> database;
+
+			std::mutex guard;
+			std::condition_variable wakeup;
+			std::thread *thread = nullptr;
+			bool enabled = true;
+
+			/// @brief Is the FTS5 index available?
+			bool indexed = false;
+
+			struct Record {
+				Logger::Level level;
+				time_t timestamp;
+				std::string domain;
+				std::string message;
+			};
+
+			std::vector<Record> records;
+
+			/// @brief Write when this number of records is pending.
+			size_t batch = 256;
+
+			/// @brief Maximum time, in seconds, a record waits for write.
+			time_t delay = 2;
+
+			/// @brief How many seconds to keep records, 0 to keep forever.
+			time_t retention = 604800;
+
+			void flush(std::vector<Record> &records);
+
+			/// @brief Remove expired records, a few at a time.
+			void trim();
+
+		public:
+			LogWriter(std::shared_ptr<Database> db, size_t batch = 256, time_t retention = 604800);
+			~LogWriter();
+
+			/// @brief Is the current thread the writer thread?
+			bool writer() const noexcept;
+
+			/// @brief Queue record, doesn't touch the database.
+			void write(Logger::Level level, const char *domain, const char *message) noexcept;
+
+			/// @brief Search records.
+			/// @param terms FTS5 query on the message text, LIKE pattern without the index.
+			/// @param call Called for each record, newest first, return false to stop.
+			void search(const char *terms, const std::function<bool(time_t timestamp, Logger::Level level, const char *domain, const char *message)> &call);
+
+		};
+
+	}
+
+ }
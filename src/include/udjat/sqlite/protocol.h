@@ -21,8 +21,16 @@
 
  #include <udjat/defs.h>
  #include <udjat/tools/protocol.h>
+ #include <udjat/tools/url.h>
+ #include <udjat/sqlite/statement.h>
+ #include <udjat/tools/logger.h>
+ #include <atomic>
  #include <list>
+ #include <map>
+ #include <vector>
  #include <mutex>
+ #include <system_error>
+ #include <iostream>
 
  namespace Udjat {
 
@@ -40,20 +48,253 @@
 			const char *list = nullptr;
 			const char *pending = nullptr;
 
+			/// @brief Queue table, when set listeners are refreshed on every committed change.
+			const char *table = "";
+
 			bool busy = false;
 
-			std::mutex guard;
+			mutable std::mutex guard;
+
+			/// @brief Queue shard, one database file with its own writer lock.
+			struct Shard {
+				std::shared_ptr<Database> database;
+
+				/// @brief Prepared statements for the send loop, swapped on reload.
+				std::shared_ptr<Statement> select;
+				std::shared_ptr<Statement> del;
+
+				/// @brief Watermark acknowledge, moves the skipped rows to the exceptions.
+				std::shared_ptr<Statement> skip;
+
+				/// @brief Watermark acknowledge, updates the delivered id.
+				std::shared_ptr<Statement> advance;
+
+				/// @brief Pipelined send, reads the next batch; arguments are last id and batch size.
+				std::shared_ptr<Statement> fetch;
+
+				/// @brief Store failed request; arguments are URL, VERB, Payload and status.
+				std::shared_ptr<Statement> dead;
+
+				/// @brief Parallel send, oldest request of each ordering key; argument is the limit.
+				std::shared_ptr<Statement> heads;
+			};
+
+			/// @brief Queued request.
+			struct Message {
+				int64_t id = 0;
+				Udjat::URL url;
+				std::string action;
+				std::string payload;
+			};
+
+			/// @brief Messages by batch on pipelined send, 1 to send one message at a time.
+			size_t batch = 1;
+
+			/// @brief Requests sent at the same time, at most one by ordering key.
+			size_t concurrency = 1;
+
+			/// @brief Send from shard in parallel, keeping the order of requests with the same key.
+			/// @return true if any message was sent.
+			bool parallel(const Shard &shard);
+
+			/// @brief Send message.
+			/// @return false if the message can't be sent (unexpected verb).
+			bool deliver(const Message &message);
+
+			/// @brief Bytes of the responses written to the log, 0 to discard them when not tracing.
+			size_t capture = 0;
+
+			/// @brief Get the number of response bytes to keep.
+			/// @param level The level for the response log.
+			/// @return The capture limit, 0 if the response is discarded.
+			size_t capturing(Logger::Level &level) const;
+
+			/// @brief Log the captured response.
+			/// @details Only successful responses are received, the worker throws on failures.
+			/// @param body The response, up to the capture limit.
+			/// @param length The full response length.
+			void received(const Message &message, Logger::Level level, const std::string &body, size_t length) const;
+
+			/// @brief Logged send events.
+			enum Event : uint8_t {
+				Sent,			///< @brief Request sent.
+				Acknowledged,	///< @brief Request removed from the queue.
+
+				Events
+			};
+
+			/// @brief Write one of each 'log-sample' send events, 1 to write all.
+			std::atomic<unsigned int> sample{1};
+
+			/// @brief Sampling counters, one for each event.
+			mutable std::atomic<unsigned int> events[Events] = {};
+
+			/// @brief Log send event, formatted on a fixed buffer only when the level is enabled.
+			void event(Logger::Level level, Event id, const Message &message) const;
+
+		public:
+
+			/// @brief Send result classes.
+			enum Result : uint8_t {
+				Success,		///< @brief 2xx, request sent.
+				Redirect,		///< @brief 3xx not followed by the client.
+				ClientError,	///< @brief 4xx.
+				ServerError,	///< @brief 5xx.
+				Failure,		///< @brief No HTTP status (network, name resolution, ...).
+				Invalid,		///< @brief Unexpected verb.
+				Results
+			};
+
+			/// @brief Get the result class of a send error.
+			/// @details Only codes from the HTTP client are statuses; system and generic
+			///          codes (connection refused, timeout, ...) are failures, even in 100-599.
+			/// @param code The error code.
+			/// @param status The HTTP status, 0 if the code isn't one.
+			static Result classify(const std::error_code &code, int &status);
+
+		private:
+
+			/// @brief What to do with the request after a send.
+			enum Action : uint8_t {
+				Delete,
+				Retry,
+				DeadLetter
+			};
+
+			/// @brief Actions by result class, with overrides by HTTP status.
+			struct Policy {
+				Action results[Results] = { Delete, DeadLetter, DeadLetter, Retry, Retry, DeadLetter };
+				std::map<int,Action> status{ {408,Retry}, {425,Retry}, {429,Retry} };
+			} policy;
+
+			/// @brief Requests by result class.
+			mutable std::atomic<size_t> counters[Results]{};
+
+			/// @brief Retry backoff, starting on 'retry-delay' and doubled on every retry.
+			struct {
+				time_t delay = 0;
+				time_t max = 3600;
+				time_t until = 0;
+			} backoff;
 
-			/// @brief Interval between URL send.
+			/// @brief Get the actions from the <on> children of node, over the defaults.
+			Policy policies(const pugi::xml_node &node) const;
+
+			/// @brief Send message and get the action for the result.
+			/// @param status The HTTP status, 0 if not available.
+			Action dispatch(const Message &message, int &status);
+
+			/// @brief Request to store as dead letter, with the HTTP status.
+			struct Letter {
+				Message message;
+				int status;
+			};
+
+			/// @brief Store message as dead letter.
+			/// @details The shard statements are shared by the senders, call it only from
+			///          acknowledge() with the shard transaction held.
+			void bury(const Shard &shard, const Message &message, int status);
+
+			/// @brief Send batches from shard, the next batch is read and the previous one
+			///        acknowledged while the current one is on the network.
+			/// @return true if any message was sent.
+			bool pipeline(const Shard &shard);
+
+			/// @brief Queue shards, the first one is the protocol database.
+			std::vector<Shard> shards;
+
+			/// @brief Shard for the next send, they are drained round robin.
+			size_t next = 0;
+
+			/// @brief Get the shard databases.
+			std::vector<std::shared_ptr<Database>> databases() const;
+
+			/// @brief Get the shard database for the destination of url.
+			std::shared_ptr<Database> route(const char *url) const;
+
+			/// @brief First retry delay, in seconds.
 			time_t send_delay = 1;
 
+			/// @brief Full text search query on the queued messages, empty if not indexed.
+			const char *search_sql = "";
+
+			/// @brief Keyset query for dump, arguments are last id and page size.
+			const char *dump_sql = "";
+
+			/// @brief Create and sync the full text index for column.
+			void index(std::shared_ptr<Database> db, const char *table, const char *column);
+
+			/// @brief Create, update or drop the indexed JSON columns declared on node.
+			void columns(std::shared_ptr<Database> db, const char *table, const pugi::xml_node &node);
+
+			/// @brief Time or size partitioned queue, 'table' is a view over the partition tables.
+			struct {
+				time_t interval = 0;	///< @brief Seconds by partition, 0 to rotate only by size.
+				size_t rows = 0;		///< @brief Rows by partition, 0 to rotate only by time.
+				time_t checked = 0;		///< @brief Time of the last maintenance.
+			} partition;
+
+			/// @brief Convert the queue table to partitions and update the view.
+			/// @return The queue key column.
+			std::string partitions(std::shared_ptr<Database> db, const char *table);
+
+			/// @brief Create view and triggers for the active partitions.
+			void build(std::shared_ptr<Database> db, const char *table);
+
+			/// @brief Refresh listeners on changes to the queue tables.
+			void listen(std::shared_ptr<Database> db, const char *table);
+
+			/// @brief Acknowledge by watermark, delivered rows are removed in ranges.
+			bool watermark = false;
+
+			/// @brief Create the watermark and exceptions tables for the queue.
+			void watermarks(std::shared_ptr<Database> db, const char *table);
+
+			/// @brief Mark requests as delivered, in one transaction.
+			/// @param letters Requests from ids stored as dead letters on the same transaction.
+			void acknowledge(const Shard &shard, const std::vector<int64_t> &ids, const std::vector<Letter> &letters = {});
+
+			/// @brief Remove the rows below the watermark, the one on it is kept so its rowid isn't reused.
+			void purge(std::shared_ptr<Database> db, const char *table);
+
+			/// @brief Rotate the current partition and drop the delivered ones, purge acknowledged rows.
+			void maintain();
+
+			/// @brief Report limits.
+			struct {
+				size_t rows = 1000;		///< @brief Maximum number of rows on report.
+				time_t time = 5;		///< @brief Maximum time, in seconds, running the report query.
+			} limits;
+
 			std::list<Abstract::Agent *> listeners;
 
 		public:
 			Protocol(std::shared_ptr<Database> db, const pugi::xml_node &node);
 			virtual ~Protocol();
 
+			/// @brief Reload SQL and tuning from node without reopening the database.
+			/// @details The new statements are prepared before being swapped in; an invalid
+			///          definition throws and leaves the active one untouched, the 'init'
+			///          statements run on the same transaction by shard and are rolled back too.
+			///          With the 'shards' attribute the queue is split on 'dbname-N' files
+			///          by destination; the number of shards is kept on 'udjat_shards' and
+			///          can only change while every shard is empty.
+			///          With 'partition-interval' or 'partition-rows' the queue table is
+			///          converted to a view over partition tables, delivered partitions are
+			///          dropped as a whole.
+			///          With acknowledge='watermark' the queue is sent in rowid order and
+			///          delivered rows are removed in ranges, 'select' and 'delete' are
+			///          generated by the protocol.
+			///          With 'send-batch' greater than 1 the send is pipelined, the queue is read
+			///          in key order and the 'select' child is not allowed.
+			///          With 'max-concurrency' greater than 1 requests are sent in parallel,
+			///          one at a time for each value of the 'ordering-key' SQL expression.
+			///          The <on status='4xx|5xx|404|error|invalid' action='delete|retry|dead-letter'/>
+			///          children set what is done with the request after a send.
+			void reload(const pugi::xml_node &node);
+
 			/// @brief Send one queued URL.
+			/// @details Sharded queues send from the next non empty shard.
 			/// @return true if the first URL was sent.
 			bool send() noexcept;
 
@@ -70,8 +311,41 @@
 			void refresh();
 
 			/// @brief Get queue.
+			/// @details Sharded queues are reported one shard after another.
 			void get(Report &report);
 
+			/// @brief Report the number of requests and the action by result class.
+			void statistics(Report &report) const;
+
+			/// @brief Search queued messages using the full text index.
+			/// @param terms FTS5 query.
+			void search(const char *terms, Report &report);
+
+			/// @brief Write queued requests to stream, one per line.
+			/// @details Lines are "id<tab>url<tab>action<tab>payload" with tab, newline and
+			///          backslash escaped; rows are read in pages on the read connection.
+			/// @return Number of requests written.
+			size_t dump(std::ostream &out);
+
+			/// @brief Insert requests from a dump.
+			/// @details Runs in one transaction by shard with the insert statement prepared once,
+			///          the queue table indexes and the full text index are rebuilt at the end.
+			/// @return Number of requests inserted.
+			size_t load(std::istream &in);
+
+			/// @brief Request to enqueue.
+			struct Entry {
+				std::string url;
+				std::string action;		///< @brief The HTTP verb.
+				std::string payload;
+			};
+
+			/// @brief Insert requests.
+			/// @details Runs in one transaction by shard, opened in shard order and committed after all
+			///          the inserts, with the insert statement prepared once.
+			/// @return Number of requests inserted.
+			size_t enqueue(const std::vector<Entry> &entries);
+
 			/// @brief Get State based on queue size.
 			std::shared_ptr<Abstract::State> state() const;
 
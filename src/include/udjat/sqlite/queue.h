@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/sqlite/database.h>
+ #include <udjat/sqlite/statement.h>
+ #include <memory>
+ #include <mutex>
+ #include <string>
+ #include <sstream>
+ #include <stdexcept>
+ #include <vector>
+
+ namespace Udjat {
+
+	namespace SQLite {
+
+		/// @brief Persistent queue of text values on the 'queue_<name>' table.
+		/// @details Consumers lease batches of entries; leased entries are hidden until
+		///          acknowledged (removed), released or the lease expires.
+		class UDJAT_API BasicQueue {
+		public:
+
+			struct Entry {
+				int64_t id = 0;
+				unsigned int attempts = 0;	///< @brief Number of leases, including this one.
+				std::string value;
+			};
+
+		private:
+			std::shared_ptr<Database> database;
+			std::mutex guard;
+
+			/// @brief Prepared once, used under the guard.
+			struct {
+				std::shared_ptr<Statement> insert;
+				std::shared_ptr<Statement> select;
+				std::shared_ptr<Statement> lease;
+				std::shared_ptr<Statement> remove;
+				std::shared_ptr<Statement> release;
+				std::shared_ptr<Statement> rowid;		///< @brief Id of the last insert, under the transaction.
+			} sql;
+
+			/// @brief The queue table.
+			std::string table;
+
+		public:
+			BasicQueue(std::shared_ptr<Database> db, const char *name);
+			~BasicQueue();
+
+			/// @brief Enqueue value, it may be binary.
+			/// @return The entry id.
+			int64_t push_back(const std::string &value);
+
+			/// @brief Enqueue values in one transaction.
+			/// @return Number of entries inserted.
+			size_t push_back(const std::vector<std::string> &values);
+
+			/// @brief Get the oldest available entries, hidden from other consumers for duration.
+			/// @param max Maximum number of entries.
+			/// @param duration Lease time, in seconds.
+			std::vector<Entry> lease(size_t max, time_t duration);
+
+			/// @brief Log an entry whose value can't be converted.
+			void rejected(const Entry &entry, const char *reason) const;
+
+			/// @brief Remove delivered entries, in one transaction.
+			void ack(const std::vector<int64_t> &ids);
+
+			/// @brief Return leased entries to the queue.
+			void release(const std::vector<int64_t> &ids);
+
+			/// @brief Number of entries, including the leased ones.
+			size_t size();
+
+			/// @brief Number of leased entries.
+			size_t leased();
+
+			/// @brief Age of the oldest entry, in seconds; 0 if empty.
+			time_t age();
+
+		};
+
+		/// @brief Queue value conversion, uses the stream operators.
+		template <typename T>
+		struct Serializer {
+
+			static std::string serialize(const T &value) {
+				std::ostringstream out;
+				out << value;
+				return out.str();
+			}
+
+			static T deserialize(const std::string &text) {
+				T value;
+				std::istringstream in{text};
+				if(!(in >> value)) {
+					throw std::runtime_error(std::string{"Unable to convert queued value '"} + text + "'");
+				}
+				return value;
+			}
+
+		};
+
+		template <>
+		struct Serializer<std::string> {
+
+			static std::string serialize(const std::string &value) {
+				return value;
+			}
+
+			static std::string deserialize(const std::string &text) {
+				return text;
+			}
+
+		};
+
+		/// @brief Persistent typed queue.
+		/// @tparam T The value type.
+		/// @tparam S Converts values to and from text (serialize/deserialize).
+		template <typename T, typename S = Serializer<T>>
+		class Queue : public BasicQueue {
+		public:
+
+			struct Entry {
+				int64_t id;
+				unsigned int attempts;
+				T value;
+			};
+
+			Queue(std::shared_ptr<Database> db, const char *name) : BasicQueue{db,name} {
+			}
+
+			int64_t push_back(const T &value) {
+				return BasicQueue::push_back(S::serialize(value));
+			}
+
+			size_t push_back(const std::vector<T> &values) {
+				std::vector<std::string> text;
+				text.reserve(values.size());
+				for(const T &value : values) {
+					text.push_back(S::serialize(value));
+				}
+				return BasicQueue::push_back(text);
+			}
+
+			/// @brief Get the oldest available entries.
+			/// @details Each value is converted on its own. The ones that can't be converted
+			///          stay leased, so they don't block the others, and are reported on
+			///          'invalid' (or logged) to be acknowledged or left to expire.
+			/// @param invalid The entries that can't be converted, with their text.
+			std::vector<Entry> lease(size_t max, time_t duration, std::vector<BasicQueue::Entry> *invalid = nullptr) {
+				std::vector<Entry> entries;
+				for(auto &entry : BasicQueue::lease(max,duration)) {
+					try {
+						entries.push_back({entry.id,entry.attempts,S::deserialize(entry.value)});
+					} catch(const std::exception &e) {
+						if(invalid) {
+							invalid->push_back(entry);
+						} else {
+							rejected(entry,e.what());
+						}
+					}
+				}
+				return entries;
+			}
+
+		};
+
+	}
+
+ }
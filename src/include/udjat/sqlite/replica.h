@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/sqlite/database.h>
+ #include <memory>
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <string>
+ #include <vector>
+ #include <deque>
+
+ struct sqlite3_session;
+
+ namespace Udjat {
+
+	namespace SQLite {
+
+		/// @brief Warm standby copy of a database, updated from session changesets.
+		/// @details The standby file starts as a backup of the primary; after that the
+		///          changes on the configured tables are recorded by a session, captured
+		///          in batches and applied by a background thread with its own connection.
+		///          A changeset that can't be applied stops the replication, the standby
+		///          is rebuilt by a new replica (on module reload).
+		class UDJAT_API Replica {
+		private:
+			std::shared_ptr<Database> database;
+			std::string filename;
+			std::vector<std::string> tables;
+
+			/// @brief Session on the primary connection (under the database guard).
+			sqlite3_session *session = nullptr;
+
+			struct Changeset {
+				time_t captured;
+				std::string data;
+			};
+
+			mutable std::mutex guard;
+			std::condition_variable wakeup;
+			std::deque<Changeset> changesets;
+			std::thread *thread = nullptr;
+			bool enabled = true;
+
+			/// @brief When the changeset that failed was captured, 0 if none failed.
+			time_t failed = 0;
+
+			/// @brief Start a new session on the primary, must be called with the database locked.
+			void start();
+
+		public:
+			/// @param db The primary database.
+			/// @param filename The standby database file.
+			/// @param tables The tables to replicate.
+			Replica(std::shared_ptr<Database> db, const char *filename, const std::vector<std::string> &tables);
+			~Replica();
+
+			/// @brief Capture the changes since the last call and queue them to the standby.
+			/// @return Size of the captured changeset, in bytes.
+			size_t capture();
+
+			/// @brief Seconds since the oldest changeset not applied to the standby, 0 if in sync.
+			time_t lag() const;
+
+			/// @brief Check if a changeset failed, the standby is no longer updated.
+			bool diverged() const;
+
+			/// @brief Number of changesets waiting for the standby.
+			size_t pending() const;
+
+		};
+
+	}
+
+ }
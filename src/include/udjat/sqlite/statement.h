@@ -23,6 +23,7 @@
  #include <sqlite3.h>
  #include <udjat/sqlite/database.h>
  #include <string>
+ #include <vector>
 
  namespace Udjat {
 
@@ -33,20 +34,41 @@
 			std::shared_ptr<Database> database;
 			sqlite3_stmt *stmt;
 
+			/// @brief Tables read by the statement.
+			std::vector<std::string> tables;
+
+			/// @brief False if the statement calls a non-deterministic function.
+			bool cacheable = true;
+
+			static int authorizer(void *statement, int action, const char *arg1, const char *arg2, const char *dbname, const char *trigger);
+
 		public:
 			Statement(std::shared_ptr<Database> database, const char *sql);
 			~Statement();
 
 			void reset();
-			void exec();
+
+			/// @brief Run statement to completion.
+			/// @return Number of rows changed.
+			size_t exec();
 
 			int step();
 
+			/// @brief Run query and get all rows.
+			/// @details Read only statements use the database result cache when enabled.
+			std::shared_ptr<const Result> fetch();
+
 			void get(int column, int64_t &value);
+			void get(int column, double &value);
 			void get(int column, std::string &value);
 
+			/// @brief Get column with all its bytes, values may have embedded NULs.
+			void bytes(int column, std::string &value);
+
 			Statement & bind(int column, const char *value);
+			Statement & bind(int column, const std::string &value);
 			Statement & bind(int column, const int64_t value);
+			Statement & bind(int column, const double value);
 
 			/// @brief Bind multiple columns.
 			Statement & bind(const char *arg,...) UDJAT_GNUC_NULL_TERMINATED;
@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/sqlite/database.h>
+ #include <memory>
+ #include <mutex>
+ #include <string>
+ #include <vector>
+ #include <unordered_map>
+ #include <functional>
+
+ namespace Udjat {
+
+	namespace SQLite {
+
+		/// @brief Time-series storage with buffered, batched writes.
+		/// @details Samples are kept in memory and written in one transaction per batch;
+		///          timestamps are stored as deltas from the series creation time.
+		///          Each flush also updates the per minute, hour and day rollups.
+		class UDJAT_API TimeSeries {
+		public:
+
+			enum Resolution : uint8_t {
+				Raw,
+				Minute,
+				Hour,
+				Day
+			};
+
+		private:
+			std::shared_ptr<Database> database;
+			std::mutex guard;
+
+			struct Sample {
+				int64_t series;
+				int64_t delta;
+				time_t timestamp;
+				double value;
+			};
+
+			/// @brief Samples waiting for flush.
+			std::vector<Sample> buffer;
+
+			struct Series {
+				int64_t id;
+				time_t base;
+			};
+
+			/// @brief Series by name.
+			std::unordered_map<std::string,Series> series;
+
+			/// @brief Series base time by id.
+			std::unordered_map<int64_t,time_t> bases;
+
+			/// @brief Get series by name, must be called with the guard.
+			/// @return false if the series doesn't exist.
+			bool find(const char *name, Series &entry);
+
+			/// @brief Held while trimming, concurrent trims are skipped.
+			std::mutex trimming;
+
+			/// @brief Flush when this number of samples is buffered.
+			size_t batch = 256;
+
+			/// @brief Maximum number of buffered samples, the oldest ones are dropped beyond it.
+			size_t limit;
+
+			/// @brief Samples dropped on buffer overflow.
+			size_t overflow = 0;
+
+			/// @brief Drop the oldest samples beyond the buffer limit, must be called with the guard.
+			void shrink();
+
+			/// @brief How many seconds to keep on each resolution, 0 to keep forever.
+			time_t retention_time[4] = { 604800, 2592000, 31536000, 0 };
+
+		public:
+			TimeSeries(std::shared_ptr<Database> db, size_t batch = 256);
+			~TimeSeries();
+
+			/// @brief Get series id, create it if needed.
+			int64_t id(const char *name);
+
+			/// @brief Buffer sample.
+			/// @return true if the buffer is full and should be flushed.
+			bool push_back(int64_t series, double value, time_t timestamp = 0);
+
+			/// @brief Number of buffered samples.
+			size_t size();
+
+			/// @brief Set the maximum number of buffered samples.
+			/// @details When flushes keep failing the oldest samples are dropped beyond it.
+			void capacity(size_t samples);
+
+			/// @brief Number of samples dropped on buffer overflow.
+			size_t dropped();
+
+			/// @brief Write buffered samples in one transaction.
+			/// @return Number of samples written.
+			size_t flush();
+
+			/// @brief Get retention time for resolution.
+			time_t retention(Resolution resolution) const;
+
+			/// @brief Set retention time for resolution (0 to keep forever).
+			void retention(Resolution resolution, time_t seconds);
+
+			/// @brief Remove expired samples, in small deletes.
+			/// @details Safe to run on a background thread, returns at once if another trim is running.
+			/// @param limit Maximum number of rows removed per delete.
+			/// @return Number of rows removed.
+			size_t trim(size_t limit = 500);
+
+			/// @brief Get the resolution used for a time range.
+			/// @return The coarsest resolution keeping at least 'points' values in the range.
+			Resolution resolution(time_t from, time_t to, size_t points = 500) const;
+
+			/// @brief Get series values.
+			/// @details Unknown series have no values, they are not created.
+			/// @param name The series name.
+			/// @param from Begin of the time range.
+			/// @param to End of the time range.
+			/// @param points Number of points wanted, used to select the resolution.
+			/// @param call Called for each value (timestamp, min, max, avg, count).
+			/// @return The resolution used.
+			Resolution get(const char *name, time_t from, time_t to, size_t points, const std::function<void(time_t timestamp, double min, double max, double avg, size_t count)> &call);
+
+		};
+
+	}
+
+ }
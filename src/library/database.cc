@@ -21,25 +21,47 @@
  #include <udjat/defs.h>
  #include <udjat/sqlite/database.h>
  #include <udjat/tools/logger.h>
+ #include <udjat/sqlite/statement.h>
  #include <iostream>
+ #include <strings.h>
+ #include <algorithm>
 
  using namespace std;
 
  namespace Udjat {
 
-	SQLite::Database::Database(const char *dbname) {
+	SQLite::Database::Database(const char *dbname, bool readonly) {
 
 		lock_guard<std::mutex> lock(guard);
 
-		cout << "sqlite\tOpening database on '" << dbname << "'" << endl;
+		cout << "sqlite\tOpening " << (readonly ? "read only " : "") << "database on '" << dbname << "'" << endl;
 
 		// Open database.
-		int rc = sqlite3_open(dbname, &db);
+		int rc = sqlite3_open_v2(dbname, &db, (readonly ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE)), NULL);
 		if(rc != SQLITE_OK) {
 			db = nullptr;
 			throw runtime_error(Logger::String("Error opening '",dbname,"'"));
         }
 
+		// Required on every connection, they can be used on indexes.
+		try {
+			functions(db);
+		} catch(...) {
+			sqlite3_close(db);
+			db = nullptr;
+			throw;
+		}
+
+		// Wait for the other connection instead of failing: the report waits for the
+		// writer, queue inserts and deletes wait for a checkpoint or another process.
+		sqlite3_busy_timeout(db,(readonly ? 1000 : 5000));
+
+		// Track changed tables to notify listeners after commit.
+		sqlite3_set_authorizer(db,authorizer,this);
+		sqlite3_update_hook(db,update_hook,this);
+		sqlite3_commit_hook(db,commit_hook,this);
+		sqlite3_rollback_hook(db,rollback_hook,this);
+
 	}
 
 	SQLite::Database::~Database() {
@@ -74,13 +96,347 @@
 			throw runtime_error("Database is not available");
 		}
 
-		lock_guard<std::mutex> lock(guard);
-		if(sqlite3_exec(db,sql,NULL,NULL,&errMsg) != SQLITE_OK) {
-			string message{errMsg};
-			sqlite3_free(errMsg);
-			throw runtime_error(message);
+		{
+			lock_guard<std::recursive_mutex> tlock(transaction);
+			lock_guard<std::mutex> lock(guard);
+			if(sqlite3_exec(db,sql,NULL,NULL,&errMsg) != SQLITE_OK) {
+				string message{errMsg};
+				sqlite3_free(errMsg);
+				throw runtime_error(message);
+			}
+		}
+
+		notify();
+
+	}
+
+	int SQLite::Database::authorizer(void *ptr, int action, const char *table, const char *, const char *, const char *) {
+
+		Database &database = *((Database *) ptr);
+
+		// A drop checks a delete on the dropped table right after the drop itself,
+		// SQLITE_IGNORE on it (or on the schema tables) would skip the drop.
+		bool dropping = database.dropping;
+		database.dropping = (action == SQLITE_DROP_TABLE || action == SQLITE_DROP_TEMP_TABLE || action == SQLITE_DROP_VIEW || action == SQLITE_DROP_TEMP_VIEW);
+
+		if(action == SQLITE_DELETE && !dropping && table && strncasecmp(table,"sqlite_",7)) {
+			// Only disables the truncate optimization, the rows are still deleted.
+			return SQLITE_IGNORE;
+		}
+
+		return SQLITE_OK;
+	}
+
+	void SQLite::Database::update_hook(void *database, int, const char *, const char *table, sqlite3_int64) {
+		((Database *) database)->changes.changed.insert(table);
+	}
+
+	int SQLite::Database::commit_hook(void *ptr) {
+
+		Database *database = (Database *) ptr;
+
+		if(!database->changes.changed.empty()) {
+			for(const string &table : database->changes.changed) {
+				database->invalidate(table);
+			}
+			lock_guard<std::mutex> lock(database->changes.guard);
+			database->changes.committed.insert(database->changes.changed.begin(),database->changes.changed.end());
+			database->changes.changed.clear();
+			database->changes.pending = true;
+		}
+
+		return 0;
+	}
+
+	void SQLite::Database::rollback_hook(void *database) {
+		((Database *) database)->changes.changed.clear();
+	}
+
+	void SQLite::Database::cache(size_t limit) {
+		lock_guard<std::mutex> lock(results.guard);
+		results.limit = limit;
+		while(results.used > results.limit && !results.entries.empty()) {
+			results.used -= results.entries.back().result->size + results.entries.back().key.size();
+			results.index.erase(results.entries.back().key);
+			results.entries.pop_back();
+		}
+	}
+
+	std::shared_ptr<const SQLite::Result> SQLite::Database::cached(const std::string &key) {
+		lock_guard<std::mutex> lock(results.guard);
+		auto it = results.index.find(key);
+		if(it == results.index.end()) {
+			return std::shared_ptr<const Result>();
+		}
+		results.entries.splice(results.entries.begin(),results.entries,it->second);
+		return it->second->result;
+	}
+
+	uint64_t SQLite::Database::epoch() {
+		lock_guard<std::mutex> lock(results.guard);
+		return results.epoch;
+	}
+
+	void SQLite::Database::cache(const std::string &key, std::shared_ptr<const Result> result, const std::vector<std::string> &tables, uint64_t epoch) {
+
+		size_t size = result->size + key.size();
+
+		lock_guard<std::mutex> lock(results.guard);
+
+		if(size > results.limit || results.index.count(key)) {
+			return;
+		}
+
+		// Don't store a result computed before a change on one of its tables.
+		for(const string &table : tables) {
+			auto version = results.versions.find(table);
+			if(version != results.versions.end() && version->second > epoch) {
+				return;
+			}
+		}
+
+		while(results.used + size > results.limit && !results.entries.empty()) {
+			results.used -= results.entries.back().result->size + results.entries.back().key.size();
+			results.index.erase(results.entries.back().key);
+			results.entries.pop_back();
+		}
+
+		results.entries.push_front({key,result,tables});
+		results.index[key] = results.entries.begin();
+		results.used += size;
+
+	}
+
+	bool SQLite::Database::cacheable(const std::vector<std::string> &tables) {
+
+		for(const string &table : tables) {
+
+			{
+				lock_guard<std::mutex> lock(results.guard);
+				auto it = results.tables.find(table);
+				if(it != results.tables.end()) {
+					if(!it->second) {
+						return false;
+					}
+					continue;
+				}
+			}
+
+			bool cacheable = false;
+
+			if(table.compare(0,7,"sqlite_") && table.compare(0,7,"pragma_")) {
+
+				// Virtual tables, declared or eponymous, and WITHOUT ROWID tables.
+				Statement select(
+					shared_from_this(),
+					"select (select count(*) from sqlite_master where type='table' and name=?1 and (sql like 'create virtual table%' or sql like '%without%rowid%')) "
+						"+ (select count(*) from pragma_module_list where name=?1)"
+				);
+
+				int64_t count = 1;
+				select.bind(1,table);
+				if(select.step() == SQLITE_ROW) {
+					select.get(0,count);
+				}
+				select.reset();
+
+				cacheable = (count == 0);
+
+			}
+
+			lock_guard<std::mutex> lock(results.guard);
+			results.tables[table] = cacheable;
+
+			if(!cacheable) {
+				return false;
+			}
+
+		}
+
+		return true;
+
+	}
+
+	void SQLite::Database::invalidate(const std::string &table) {
+
+		lock_guard<std::mutex> lock(results.guard);
+
+		if(!results.limit) {
+			return;
+		}
+
+		results.versions[table] = ++results.epoch;
+
+		for(auto it = results.entries.begin(); it != results.entries.end();) {
+			if(std::find(it->tables.begin(),it->tables.end(),table) != it->tables.end()) {
+				results.used -= it->result->size + it->key.size();
+				results.index.erase(it->key);
+				it = results.entries.erase(it);
+			} else {
+				it++;
+			}
+		}
+
+	}
+
+	std::shared_ptr<const SQLite::Result> SQLite::Database::fetch(const char *sql) {
+
+		if(results.limit) {
+			// Without parameters the expanded SQL is the SQL itself, no need to prepare on hit.
+			auto result = cached(sql);
+			if(result) {
+				return result;
+			}
+		}
+
+		return Statement(shared_from_this(),sql).fetch();
+	}
+
+	void SQLite::Database::insert(const void *id, const char *table, const std::function<void(const char *table)> &call) {
+
+		{
+			Statement select(shared_from_this(),"select count(*) from sqlite_master where type='table' and name=? and sql like '%without%rowid%'");
+			select.bind(1,string{table});
+			int64_t count = 0;
+			if(select.step() == SQLITE_ROW) {
+				select.get(0,count);
+			}
+			select.reset();
+			if(count) {
+				throw runtime_error(string{"Can't listen to '"} + table + "', changes on WITHOUT ROWID tables are not notified");
+			}
+		}
+
+		lock_guard<std::mutex> lock(changes.guard);
+		changes.listeners.push_back({id,table,call});
+	}
+
+	void SQLite::Database::remove(const void *id) {
+		lock_guard<std::mutex> lock(changes.guard);
+		changes.listeners.remove_if([id](const Listener &listener){
+			return listener.id == id;
+		});
+	}
+
+	void SQLite::Database::notify() {
+
+		if(!changes.pending) {
+			return;
+		}
+
+		std::list<std::pair<std::string,std::function<void(const char *table)>>> calls;
+		{
+			lock_guard<std::mutex> lock(changes.guard);
+			for(const string &table : changes.committed) {
+				for(const Listener &listener : changes.listeners) {
+					if(listener.table == table) {
+						calls.emplace_back(table,listener.call);
+					}
+				}
+			}
+			changes.committed.clear();
+			changes.pending = false;
+		}
+
+		for(auto &call : calls) {
+			try {
+				call.second(call.first.c_str());
+			} catch(const std::exception &e) {
+				cerr << "sqlite\tError notifying change on '" << call.first << "': " << e.what() << endl;
+			}
+		}
+
+	}
+
+	SQLite::Database::Transaction::Transaction(Database &db) : database{db} {
+		database.transaction.lock();
+		try {
+			{
+				// With the transaction lock held an open transaction is from this thread.
+				lock_guard<std::mutex> lock(database.guard);
+				nested = (database.db && !sqlite3_get_autocommit(database.db));
+			}
+			database.exec(nested ? "SAVEPOINT udjat_transaction" : "BEGIN");
+		} catch(...) {
+			database.transaction.unlock();
+			throw;
+		}
+	}
+
+	SQLite::Database::Transaction::Transaction(std::shared_ptr<Database> db) : Transaction(*db) {
+		owner = db;
+	}
+
+	SQLite::Database::Transaction::~Transaction() {
+		if(active) {
+			try {
+				database.exec(nested ? "ROLLBACK TO udjat_transaction; RELEASE udjat_transaction" : "ROLLBACK");
+			} catch(const std::exception &e) {
+				cerr << "sqlite\tError rolling back transaction: " << e.what() << endl;
+			}
+		}
+		database.transaction.unlock();
+	}
+
+	void SQLite::Database::Transaction::commit() {
+		database.exec(nested ? "RELEASE udjat_transaction" : "COMMIT");
+		active = false;
+	}
+
+	void SQLite::Database::extend(const std::function<void(sqlite3 *db)> &method) {
+
+		{
+			lock_guard<std::mutex> lock(guard);
+			method(db);
+		}
+
+		lock_guard<std::mutex> lock(changes.guard);
+		extensions.push_back(method);
+		if(read_connection) {
+			read_connection->extend(method);
+		}
+
+	}
+
+	const char * SQLite::Database::filename() const {
+		const char *filename = (db ? sqlite3_db_filename(db,"main") : nullptr);
+		return filename ? filename : "";
+	}
+
+	std::shared_ptr<SQLite::Database> SQLite::Database::reader() {
+
+		{
+			lock_guard<std::mutex> lock(changes.guard);
+			if(read_connection) {
+				return read_connection;
+			}
+		}
+
+		const char *filename = this->filename();
+		if(!*filename) {
+			return shared_from_this();
+		}
+
+		// With WAL the report doesn't block the writer while it's reading.
+		// Not under the changes guard, the commit hook takes it with the database guard.
+		{
+			lock_guard<std::recursive_mutex> tlock(transaction);
+			lock_guard<std::mutex> lock(guard);
+			if(sqlite3_exec(db,"pragma journal_mode=WAL",NULL,NULL,NULL) != SQLITE_OK) {
+				cerr << "sqlite\tUnable to enable WAL on '" << filename << "': " << sqlite3_errmsg(db) << endl;
+			}
+		}
+
+		lock_guard<std::mutex> lock(changes.guard);
+
+		if(!read_connection) {
+			read_connection = make_shared<Database>(filename,true);
+			for(auto &extension : extensions) {
+				read_connection->extend(extension);
+			}
 		}
 
+		return read_connection;
 	}
 
 	void SQLite::Database::check(int rc) {
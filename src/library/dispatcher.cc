@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <pugixml.hpp>
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/sqlite/database.h>
+ #include <udjat/sqlite/statement.h>
+ #include <udjat/sqlite/protocol.h>
+ #include <udjat/tools/mainloop.h>
+ #include <udjat/tools/logger.h>
+ #include <condition_variable>
+ #include <future>
+ #include <list>
+ #include <set>
+ #include <string>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	bool SQLite::Protocol::parallel(const Shard &shard) {
+
+		size_t limit;
+		{
+			lock_guard<mutex> lock(guard);
+			limit = concurrency;
+		}
+
+		struct {
+			std::mutex guard;
+			std::condition_variable finished;
+
+			/// @brief Ordering keys with a request on the network.
+			std::set<std::string> keys;
+
+			size_t sent = 0;
+			bool retry = false;
+		} state;
+
+		std::list<std::future<void>> tasks;
+
+		for(;;) {
+
+			std::vector<std::pair<Message,std::string>> heads;
+
+			{
+				std::unique_lock<std::mutex> lock(state.guard);
+
+				// Wait for a free slot.
+				state.finished.wait(lock,[&state,limit]() {
+					return state.retry || state.keys.size() < limit;
+				});
+
+				if(state.retry || !(MainLoop::getInstance() && Protocol::verify(this))) {
+					break;
+				}
+
+				// The heads of the keys in flight are returned too, skip them.
+				Statement &select = *shard.heads;
+				select.reset();
+				select.bind(1,(int64_t) (limit + state.keys.size()));
+				while(select.step() == SQLITE_ROW && (state.keys.size() + heads.size()) < limit) {
+
+					heads.emplace_back();
+					select.get(0,heads.back().first.id);
+					select.get(1,heads.back().first.url);
+					select.get(2,heads.back().first.action);
+					select.get(3,heads.back().first.payload);
+					select.get(4,heads.back().second);
+
+					if(state.keys.count(heads.back().second)) {
+						heads.pop_back();
+					}
+
+				}
+				select.reset();
+
+				if(heads.empty()) {
+
+					if(state.keys.empty()) {
+						break;
+					}
+
+					// Everything left is waiting for a request on the network.
+					size_t running = state.keys.size();
+					state.finished.wait(lock,[&state,running]() {
+						return state.retry || state.keys.size() < running;
+					});
+					continue;
+
+				}
+
+				for(auto &head : heads) {
+					state.keys.insert(head.second);
+				}
+
+			}
+
+			for(auto &head : heads) {
+
+				tasks.push_back(std::async(std::launch::async,[this,&shard,&state,head]() {
+
+					int status;
+					Action action = Retry;
+
+					try {
+
+						action = dispatch(head.first,status);
+
+						if(action != Retry) {
+							std::vector<Letter> letters;
+							if(action == DeadLetter) {
+								letters.push_back({head.first,status});
+							}
+							event(Logger::Info,Acknowledged,head.first);
+							acknowledge(shard,{head.first.id},letters);
+						}
+
+					} catch(const std::exception &e) {
+
+						warning() << "Error acknowledging request '" << head.first.id << "': " << e.what() << endl;
+						action = Retry;
+
+					}
+
+					// Release the key only after the acknowledge, the next head is read without this request.
+					{
+						lock_guard<mutex> lock(state.guard);
+						state.keys.erase(head.second);
+						if(action == Retry) {
+							state.retry = true;
+						} else {
+							state.sent++;
+						}
+					}
+					state.finished.notify_all();
+
+				}));
+
+			}
+
+			// Forget the finished tasks.
+			tasks.remove_if([](const std::future<void> &task) {
+				return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			});
+
+		}
+
+		for(auto &task : tasks) {
+			task.wait();
+		}
+
+		return state.sent > 0;
+
+	}
+
+ }
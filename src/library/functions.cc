@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/sqlite/database.h>
+ #include <cstring>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Parsed URL, pointers to the original text.
+	struct URLParts {
+
+		const char *scheme = "";
+		size_t scheme_length = 0;
+
+		const char *host = "";
+		size_t host_length = 0;
+
+		const char *path = "";
+		size_t path_length = 0;
+
+		URLParts(const char *url) {
+
+			const char *ptr = strstr(url,"://");
+			if(!ptr) {
+				// No authority, everything up to the query is the path.
+				path = url;
+				path_length = strcspn(url,"?#");
+				return;
+			}
+
+			scheme = url;
+			scheme_length = ptr - url;
+
+			// Authority is "[user@]host[:port]".
+			const char *authority = ptr+3;
+			size_t authority_length = strcspn(authority,"/?#");
+
+			host = authority;
+			host_length = authority_length;
+
+			const char *at = (const char *) memchr(host,'@',host_length);
+			if(at) {
+				host_length -= (at+1) - host;
+				host = at+1;
+			}
+
+			if(*host == '[') {
+				// IPv6 literal.
+				const char *end = (const char *) memchr(host,']',host_length);
+				if(end) {
+					host_length = (end+1) - host;
+				}
+			} else {
+				const char *port = (const char *) memchr(host,':',host_length);
+				if(port) {
+					host_length = port - host;
+				}
+			}
+
+			path = authority + authority_length;
+			path_length = strcspn(path,"?#");
+
+		}
+
+	};
+
+	static void url_scheme(sqlite3_context *context, int, sqlite3_value **argv) {
+		const char *url = (const char *) sqlite3_value_text(argv[0]);
+		if(!url) {
+			sqlite3_result_null(context);
+			return;
+		}
+		URLParts parts{url};
+		sqlite3_result_text(context,parts.scheme,parts.scheme_length,SQLITE_TRANSIENT);
+	}
+
+	static void url_host(sqlite3_context *context, int, sqlite3_value **argv) {
+		const char *url = (const char *) sqlite3_value_text(argv[0]);
+		if(!url) {
+			sqlite3_result_null(context);
+			return;
+		}
+		URLParts parts{url};
+		sqlite3_result_text(context,parts.host,parts.host_length,SQLITE_TRANSIENT);
+	}
+
+	static void url_path(sqlite3_context *context, int, sqlite3_value **argv) {
+		const char *url = (const char *) sqlite3_value_text(argv[0]);
+		if(!url) {
+			sqlite3_result_null(context);
+			return;
+		}
+		URLParts parts{url};
+		sqlite3_result_text(context,parts.path,parts.path_length,SQLITE_TRANSIENT);
+	}
+
+	/// @brief 64 bits FNV-1a hash of the value.
+	static void payload_hash(sqlite3_context *context, int, sqlite3_value **argv) {
+
+		const unsigned char *data;
+		size_t length;
+
+		switch(sqlite3_value_type(argv[0])) {
+		case SQLITE_NULL:
+			sqlite3_result_null(context);
+			return;
+
+		case SQLITE_BLOB:
+			data = (const unsigned char *) sqlite3_value_blob(argv[0]);
+			length = sqlite3_value_bytes(argv[0]);
+			break;
+
+		default:
+			// Text is hashed up to the first NUL, the same for values bound with or without it.
+			data = sqlite3_value_text(argv[0]);
+			length = (data ? strlen((const char *) data) : 0);
+		}
+
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for(size_t ix = 0; ix < length; ix++) {
+			hash ^= data[ix];
+			hash *= 0x100000001b3ULL;
+		}
+
+		sqlite3_result_int64(context,(sqlite3_int64) hash);
+
+	}
+
+	void SQLite::Database::functions(sqlite3 *db) {
+
+#ifdef SQLITE_INNOCUOUS
+		// Allowed on indexes and generated columns even with trusted_schema off.
+		static const int flags = SQLITE_UTF8|SQLITE_DETERMINISTIC|SQLITE_INNOCUOUS;
+#else
+		static const int flags = SQLITE_UTF8|SQLITE_DETERMINISTIC;
+#endif // SQLITE_INNOCUOUS
+
+		static const struct {
+			const char *name;
+			void (*func)(sqlite3_context *, int, sqlite3_value **);
+		} functions[] = {
+			{ "url_scheme",		url_scheme		},
+			{ "url_host",		url_host		},
+			{ "url_path",		url_path		},
+			{ "payload_hash",	payload_hash	},
+		};
+
+		for(auto &function : functions) {
+			if(sqlite3_create_function(db,function.name,1,flags,NULL,function.func,NULL,NULL) != SQLITE_OK) {
+				throw runtime_error(sqlite3_errmsg(db));
+			}
+		}
+
+	}
+
+ }
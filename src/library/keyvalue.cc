@@ -0,0 +1,361 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/sqlite/keyvalue.h>
+ #include <udjat/sqlite/statement.h>
+ #include <iostream>
+ #include <chrono>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	SQLite::KeyValue::KeyValue(std::shared_ptr<Database> db, const char *n, Durability d) : database{db}, ns{n}, durability{d} {
+
+		database->exec(
+			"create table if not exists kv ("
+				"ns text not null, "
+				"key text not null, "
+				"value blob, "
+				"primary key (ns,key)"
+			") without rowid"
+		);
+
+		if(durability == Batched) {
+
+			thread = new std::thread([this]() {
+
+				std::unique_lock<std::mutex> lock(guard);
+				while(enabled) {
+
+					if(pending.writes.empty()) {
+						wakeup.wait(lock);
+						continue;
+					}
+
+					time_t wait = pending.since + pending.delay - time(0);
+					if(wait > 0) {
+						wakeup.wait_for(lock,std::chrono::seconds(wait));
+						continue;
+					}
+
+					lock.unlock();
+					try {
+						flush();
+					} catch(const std::exception &e) {
+						cerr << "sqlite\tError flushing '" << ns << "' key-value store: " << e.what() << endl;
+					}
+					lock.lock();
+
+				}
+
+			});
+
+		}
+
+	}
+
+	SQLite::KeyValue::~KeyValue() {
+
+		if(thread) {
+			{
+				lock_guard<mutex> lock(guard);
+				enabled = false;
+			}
+			wakeup.notify_all();
+			thread->join();
+			delete thread;
+		}
+
+		try {
+			flush();
+		} catch(const std::exception &e) {
+			cerr << "sqlite\tError flushing '" << ns << "' key-value store: " << e.what() << endl;
+		}
+	}
+
+	void SQLite::KeyValue::cache_size(size_t entries) {
+		lock_guard<mutex> lock(guard);
+		cache.max = entries;
+		while(cache.entries.size() > cache.max) {
+			cache.index.erase(cache.entries.back().first);
+			cache.entries.pop_back();
+		}
+	}
+
+	void SQLite::KeyValue::batch(size_t writes, time_t delay) {
+		{
+			lock_guard<mutex> lock(guard);
+			pending.max = writes;
+			pending.delay = delay;
+		}
+		wakeup.notify_all();
+	}
+
+	void SQLite::KeyValue::cache_put(const std::string &key, const std::string &value) {
+
+		if(!cache.max) {
+			return;
+		}
+
+		auto it = cache.index.find(key);
+		if(it != cache.index.end()) {
+			it->second->second = value;
+			cache.entries.splice(cache.entries.begin(),cache.entries,it->second);
+			return;
+		}
+
+		cache.entries.emplace_front(key,value);
+		cache.index[key] = cache.entries.begin();
+
+		if(cache.entries.size() > cache.max) {
+			cache.index.erase(cache.entries.back().first);
+			cache.entries.pop_back();
+		}
+
+	}
+
+	void SQLite::KeyValue::uncache(const std::string &key) {
+		auto it = cache.index.find(key);
+		if(it != cache.index.end()) {
+			cache.entries.erase(it->second);
+			cache.index.erase(it);
+		}
+	}
+
+	bool SQLite::KeyValue::get(const std::string &key, std::string &value) {
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			auto write = pending.writes.find(key);
+			if(write != pending.writes.end()) {
+				if(write->second.removed) {
+					return false;
+				}
+				value = write->second.value;
+				return true;
+			}
+
+			auto it = cache.index.find(key);
+			if(it != cache.index.end()) {
+				cache.entries.splice(cache.entries.begin(),cache.entries,it->second);
+				value = it->second->second;
+				return true;
+			}
+
+			reading[key].readers++;
+		}
+
+		bool found = false;
+		try {
+
+			Statement select(database,"select value from kv where ns=? and key=?");
+			select.bind(1,ns).bind(2,key);
+			if(select.step() == SQLITE_ROW) {
+				select.bytes(0,value);
+				found = true;
+			}
+			select.reset();
+
+		} catch(...) {
+
+			lock_guard<mutex> lock(guard);
+			if(!--reading[key].readers) {
+				reading.erase(key);
+			}
+			throw;
+
+		}
+
+		lock_guard<mutex> lock(guard);
+
+		// Changed while reading, the value read may be older than the flushed one.
+		auto &state = reading[key];
+		if(found && !state.stale) {
+			cache_put(key,value);
+		}
+		if(!--state.readers) {
+			reading.erase(key);
+		}
+
+		return found;
+	}
+
+	void SQLite::KeyValue::changed(const std::string &key) {
+		auto it = reading.find(key);
+		if(it != reading.end()) {
+			it->second.stale = true;
+		}
+	}
+
+	void SQLite::KeyValue::write(const std::string &key, const Write &write) {
+
+		if(durability == Immediate) {
+			if(write.removed) {
+				Statement(database,"delete from kv where ns=? and key=?").bind(1,ns).bind(2,key).exec();
+			} else {
+				Statement(database,"insert or replace into kv (ns,key,value) values (?,?,?)").bind(1,ns).bind(2,key).bind(3,write.value).exec();
+			}
+
+			// A get() started after put() or remove() may have cached the row before the write.
+			lock_guard<mutex> lock(guard);
+			changed(key);
+			if(write.removed) {
+				uncache(key);
+			} else {
+				cache_put(key,write.value);
+			}
+			return;
+		}
+
+		bool full;
+		{
+			lock_guard<mutex> lock(guard);
+			if(pending.writes.empty()) {
+				// Start the age timer on the background thread.
+				pending.since = time(0);
+				wakeup.notify_all();
+			}
+			pending.writes[key] = write;
+			full = (pending.writes.size() >= pending.max || (time(0) - pending.since) >= pending.delay);
+		}
+
+		if(full) {
+			flush();
+		}
+
+	}
+
+	void SQLite::KeyValue::put(const std::string &key, const std::string &value) {
+		{
+			lock_guard<mutex> lock(guard);
+			changed(key);
+			cache_put(key,value);
+		}
+		write(key,Write{false,value});
+	}
+
+	void SQLite::KeyValue::remove(const std::string &key) {
+		{
+			lock_guard<mutex> lock(guard);
+			changed(key);
+			uncache(key);
+		}
+		write(key,Write{true,""});
+	}
+
+	void SQLite::KeyValue::flush() {
+
+		// One flush at a time, an older batch can't overwrite a newer one.
+		lock_guard<mutex> serialize(flushing);
+
+		// The writes stay pending until committed, get() reads them instead of the old rows.
+		std::map<std::string,Write> writes;
+		{
+			lock_guard<mutex> lock(guard);
+			writes = pending.writes;
+		}
+
+		if(writes.empty()) {
+			return;
+		}
+
+		try {
+
+			Database::Transaction transaction{database};
+			Statement insert(database,"insert or replace into kv (ns,key,value) values (?,?,?)");
+			Statement del(database,"delete from kv where ns=? and key=?");
+
+			for(auto &it : writes) {
+				if(it.second.removed) {
+					del.reset();
+					del.bind(1,ns).bind(2,it.first).exec();
+				} else {
+					insert.reset();
+					insert.bind(1,ns).bind(2,it.first).bind(3,it.second.value).exec();
+				}
+			}
+
+			transaction.commit();
+
+		} catch(...) {
+
+			// Keep the writes, retried after the delay.
+			lock_guard<mutex> lock(guard);
+			pending.since = time(0);
+			throw;
+
+		}
+
+		// Drop the committed writes, unless changed while flushing.
+		lock_guard<mutex> lock(guard);
+		for(auto &it : writes) {
+			auto write = pending.writes.find(it.first);
+			if(write != pending.writes.end() && write->second.removed == it.second.removed && write->second.value == it.second.value) {
+				pending.writes.erase(write);
+			}
+		}
+		if(!pending.writes.empty()) {
+			pending.since = time(0);
+		}
+
+	}
+
+	void SQLite::KeyValue::scan(const std::string &prefix, const std::function<bool(const std::string &key, const std::string &value)> &call) {
+
+		// Pending writes are flushed so the table has the current state.
+		flush();
+
+		// Upper bound is the prefix with the last byte incremented.
+		std::string upper{prefix};
+		while(!upper.empty() && ((unsigned char) upper.back()) == 0xFF) {
+			upper.pop_back();
+		}
+		if(!upper.empty()) {
+			upper.back()++;
+		}
+
+		Statement select(
+			database,
+			upper.empty()
+				? "select key,value from kv where ns=?1 and key >= ?2 order by key"
+				: "select key,value from kv where ns=?1 and key >= ?2 and key < ?3 order by key"
+		);
+
+		select.bind(1,ns).bind(2,prefix);
+		if(!upper.empty()) {
+			select.bind(3,upper);
+		}
+
+		std::string key, value;
+		while(select.step() == SQLITE_ROW) {
+			select.bytes(0,key);
+			select.bytes(1,value);
+			if(!call(key,value)) {
+				break;
+			}
+		}
+
+		select.reset();
+
+	}
+
+ }
@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/sqlite/logwriter.h>
+ #include <udjat/sqlite/statement.h>
+ #include <iostream>
+ #include <chrono>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	SQLite::LogWriter::LogWriter(std::shared_ptr<Database> db, size_t b, time_t r) : database{db}, batch{b}, retention{r} {
+
+		database->exec(
+			"create table if not exists log ("
+				"id integer primary key, "
+				"level integer, "
+				"domain text, "
+				"timestamp integer, "
+				"message text"
+			")"
+		);
+
+		database->exec("create index if not exists log_timestamp on log (timestamp)");
+
+		try {
+
+			database->exec("create virtual table if not exists log_fts using fts5(message, content='log', content_rowid='id')");
+			database->exec(
+				"create trigger if not exists log_fts_insert after insert on log begin "
+					"insert into log_fts (rowid,message) values (new.id,new.message); "
+				"end"
+			);
+			database->exec(
+				"create trigger if not exists log_fts_delete after delete on log begin "
+					"insert into log_fts (log_fts,rowid,message) values ('delete',old.id,old.message); "
+				"end"
+			);
+			indexed = true;
+
+		} catch(const std::exception &e) {
+
+			cerr << "sqlite\tFull text search on log is not available: " << e.what() << endl;
+
+		}
+
+		records.reserve(batch);
+
+		thread = new std::thread([this]() {
+
+			std::vector<Record> pending;
+			time_t last_trim = 0;
+
+			std::unique_lock<std::mutex> lock(guard);
+			while(enabled || !records.empty()) {
+
+				if(records.size() < batch && enabled) {
+					wakeup.wait_for(lock,std::chrono::seconds(delay));
+				}
+
+				if(records.empty()) {
+					continue;
+				}
+
+				pending.swap(records);
+				records.reserve(batch);
+
+				lock.unlock();
+				flush(pending);
+				pending.clear();
+
+				if(retention && time(0) - last_trim >= 60) {
+					last_trim = time(0);
+					trim();
+				}
+				lock.lock();
+
+			}
+
+		});
+
+	}
+
+	SQLite::LogWriter::~LogWriter() {
+
+		{
+			lock_guard<mutex> lock(guard);
+			enabled = false;
+		}
+		wakeup.notify_all();
+
+		thread->join();
+		delete thread;
+
+	}
+
+	bool SQLite::LogWriter::writer() const noexcept {
+		return thread && thread->get_id() == std::this_thread::get_id();
+	}
+
+	void SQLite::LogWriter::write(Logger::Level level, const char *domain, const char *message) noexcept {
+
+		try {
+
+			size_t count;
+			{
+				lock_guard<mutex> lock(guard);
+				if(!enabled) {
+					return;
+				}
+				records.push_back({level,time(0),domain,message});
+				count = records.size();
+			}
+
+			if(count >= batch) {
+				wakeup.notify_one();
+			}
+
+		} catch(...) {
+			// Logging must not throw.
+		}
+
+	}
+
+	void SQLite::LogWriter::flush(std::vector<Record> &records) {
+
+		try {
+
+			Database::Transaction transaction{database};
+			Statement insert(database,"insert into log (level,domain,timestamp,message) values (?,?,?,?)");
+
+			for(const Record &record : records) {
+				insert.reset();
+				insert.bind(1,(int64_t) record.level)
+						.bind(2,record.domain)
+						.bind(3,(int64_t) record.timestamp)
+						.bind(4,record.message)
+						.exec();
+			}
+
+			transaction.commit();
+
+		} catch(const std::exception &e) {
+
+			cerr << "sqlite\tError writing " << records.size() << " log record(s): " << e.what() << endl;
+
+		}
+
+	}
+
+	void SQLite::LogWriter::trim() {
+
+		try {
+
+			Statement del(database,"delete from log where id in (select id from log where timestamp < ? limit 500)");
+			size_t removed;
+			do {
+				del.reset();
+				removed = del.bind(1,(int64_t) (time(0) - retention)).exec();
+				std::this_thread::yield();
+			} while(removed);
+
+		} catch(const std::exception &e) {
+
+			cerr << "sqlite\tError removing expired log records: " << e.what() << endl;
+
+		}
+
+	}
+
+	void SQLite::LogWriter::search(const char *terms, const std::function<bool(time_t timestamp, Logger::Level level, const char *domain, const char *message)> &call) {
+
+		Statement select(
+			database,
+			indexed
+				? "select log.timestamp,log.level,log.domain,log.message from log_fts join log on log.id = log_fts.rowid where log_fts match ? order by log.id desc"
+				: "select timestamp,level,domain,message from log where message like ? order by id desc"
+		);
+
+		select.bind(1,std::string{terms});
+
+		std::string domain, message;
+		while(select.step() == SQLITE_ROW) {
+
+			int64_t timestamp, level;
+			select.get(0,timestamp);
+			select.get(1,level);
+			select.get(2,domain);
+			select.get(3,message);
+
+			if(!call((time_t) timestamp,(Logger::Level) level,domain.c_str(),message.c_str())) {
+				break;
+			}
+
+		}
+
+		select.reset();
+
+	}
+
+ }
@@ -0,0 +1,364 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <pugixml.hpp>
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/sqlite/database.h>
+ #include <udjat/sqlite/statement.h>
+ #include <udjat/sqlite/protocol.h>
+ #include <udjat/tools/logger.h>
+ #include <string>
+ #include <vector>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Queue partition.
+	struct Partition {
+		std::string name;
+		int64_t base;		///< @brief Keys on partition are greater than base.
+		time_t created;
+	};
+
+	/// @brief Get partitions of table, oldest first.
+	static std::vector<Partition> partitions_of(std::shared_ptr<SQLite::Database> db, const char *table) {
+
+		std::vector<Partition> partitions;
+
+		SQLite::Statement select(db,"select name,base,created from udjat_partitions where tbl=? order by base");
+		select.bind(1,string{table});
+
+		while(select.step() == SQLITE_ROW) {
+			Partition partition;
+			int64_t created;
+			select.get(0,partition.name);
+			select.get(1,partition.base);
+			select.get(2,created);
+			partition.created = (time_t) created;
+			partitions.push_back(partition);
+		}
+		select.reset();
+
+		return partitions;
+	}
+
+	/// @brief Column from the partition definition.
+	struct Column {
+		std::string name;
+		std::string value;	///< @brief Default value, empty if none.
+		bool key;
+	};
+
+	static std::vector<Column> columns_of(std::shared_ptr<SQLite::Database> db, const std::string &partition) {
+
+		std::vector<Column> columns;
+
+		SQLite::Statement select(db,"select name,coalesce(dflt_value,''),pk = 1 and upper(type) = 'INTEGER' from pragma_table_info(?) order by cid");
+		select.bind(1,partition);
+
+		while(select.step() == SQLITE_ROW) {
+			Column column;
+			int64_t key;
+			select.get(0,column.name);
+			select.get(1,column.value);
+			select.get(2,key);
+			column.key = (key != 0);
+			columns.push_back(column);
+		}
+		select.reset();
+
+		return columns;
+	}
+
+	static std::string key_of(const std::vector<Column> &columns, const std::string &partition) {
+		for(const Column &column : columns) {
+			if(column.key) {
+				return column.name;
+			}
+		}
+		throw runtime_error(string{"Partitioned queues requires an 'integer primary key' on '"} + partition + "'");
+	}
+
+	static int64_t integer(std::shared_ptr<SQLite::Database> db, const std::string &sql, const std::vector<int64_t> &args = std::vector<int64_t>()) {
+		SQLite::Statement select(db,sql.c_str());
+		for(size_t arg = 0; arg < args.size(); arg++) {
+			select.bind(arg+1,args[arg]);
+		}
+		int64_t value = 0;
+		if(select.step() == SQLITE_ROW) {
+			select.get(0,value);
+		}
+		select.reset();
+		return value;
+	}
+
+	std::string SQLite::Protocol::partitions(std::shared_ptr<Database> db, const char *table) {
+
+		db->exec(
+			"create table if not exists udjat_partitions ("
+				"tbl text not null, "
+				"name text not null, "
+				"base integer not null, "
+				"created integer not null, "
+				"primary key (tbl,name)"
+			") without rowid"
+		);
+
+		Database::Transaction transaction{db};
+
+		string type;
+		{
+			Statement select(db,"select type from sqlite_master where name=?");
+			select.bind(1,string{table});
+			if(select.step() == SQLITE_ROW) {
+				select.get(0,type);
+			}
+			select.reset();
+		}
+
+		if(type == "table") {
+
+			// The current rows are the first partition.
+			string name{string{table} + "_0"};
+
+			info() << "Converting queue '" << table << "' to partitioned" << endl;
+
+			db->exec((string{"alter table \""} + table + "\" rename to \"" + name + "\"").c_str());
+			Statement(db,"insert into udjat_partitions (tbl,name,base,created) values (?,?,0,?)")
+				.bind(1,string{table})
+				.bind(2,name)
+				.bind(3,(int64_t) time(0))
+				.exec();
+
+		} else if(type != "view") {
+			throw runtime_error(string{"Queue table '"} + table + "' not found");
+		}
+
+		// Keys of the delivered messages, appended in order and removed by range with the partition.
+		db->exec((string{"create table if not exists \""} + table + "_delivered\" (id integer primary key)").c_str());
+
+		build(db,table);
+
+		auto partitions = partitions_of(db,table);
+		string key{key_of(columns_of(db,partitions.back().name),partitions.back().name)};
+
+		transaction.commit();
+
+		return key;
+
+	}
+
+	void SQLite::Protocol::build(std::shared_ptr<Database> db, const char *table) {
+
+		auto partitions = partitions_of(db,table);
+		if(partitions.empty()) {
+			throw runtime_error(string{"No partitions for queue '"} + table + "'");
+		}
+
+		const Partition &current = partitions.back();
+		auto columns = columns_of(db,current.name);
+		string key{key_of(columns,current.name)};
+		string delivered{string{"\""} + table + "_delivered\""};
+
+		// Logical queue, delivered messages are hidden until the partition is dropped.
+		string sql{string{"create view \""} + table + "\" as "};
+		for(size_t ix = 0; ix < partitions.size(); ix++) {
+			if(ix) {
+				sql += " union all ";
+			}
+			sql += "select * from \"" + partitions[ix].name + "\" where not exists (select 1 from " + delivered + " where id = \"" + partitions[ix].name + "\".\"" + key + "\")";
+		}
+
+		db->exec((string{"drop view if exists \""} + table + "\"").c_str());
+		db->exec(sql.c_str());
+
+		// Inserts go to the current partition, keys continue from the previous one.
+		string names, values;
+		for(const Column &column : columns) {
+
+			if(!names.empty()) {
+				names += ",";
+				values += ",";
+			}
+			names += "\"" + column.name + "\"";
+
+			if(column.key) {
+				values += "coalesce((select max(\"" + key + "\") from \"" + current.name + "\")," + std::to_string(current.base) + ")+1";
+			} else if(column.value.empty()) {
+				values += "new.\"" + column.name + "\"";
+			} else {
+				// Views have no defaults, use the partition ones.
+				values += "coalesce(new.\"" + column.name + "\"," + column.value + ")";
+			}
+
+		}
+
+		db->exec((
+			string{"create trigger \""} + table + "_insert\" instead of insert on \"" + table + "\" begin "
+				"insert into \"" + current.name + "\" (" + names + ") values (" + values + "); "
+			"end"
+		).c_str());
+
+		db->exec((
+			string{"create trigger \""} + table + "_delete\" instead of delete on \"" + table + "\" begin "
+				"insert or ignore into " + delivered + " (id) values (old.\"" + key + "\"); "
+			"end"
+		).c_str());
+
+	}
+
+	void SQLite::Protocol::listen(std::shared_ptr<Database> db, const char *table) {
+
+		db->remove(this);
+
+		// The view isn't changed, listen to the tables behind it.
+		std::vector<string> tables{string{table} + "_delivered"};
+		for(const Partition &partition : partitions_of(db,table)) {
+			tables.push_back(partition.name);
+		}
+
+		for(const string &name : tables) {
+			db->insert(this,name.c_str(),[this](const char *) {
+				refresh();
+			});
+		}
+
+	}
+
+	void SQLite::Protocol::maintain() {
+
+		const char *table;
+		time_t interval;
+		size_t rows;
+		bool watermark;
+		{
+			lock_guard<mutex> lock(guard);
+
+			if(!(partition.interval || partition.rows || this->watermark)) {
+				return;
+			}
+
+			// Counting rows isn't free, check at most once by minute.
+			time_t now = time(0);
+			if(now - partition.checked < 60) {
+				return;
+			}
+			partition.checked = now;
+
+			table = this->table;
+			interval = partition.interval;
+			rows = partition.rows;
+			watermark = this->watermark;
+		}
+
+		for(auto db : databases()) {
+
+			if(watermark) {
+				purge(db,table);
+				continue;
+			}
+
+			bool changed = false;
+
+			{
+				Database::Transaction transaction{db};
+
+				string delivered{string{"\""} + table + "_delivered\""};
+				auto partitions = partitions_of(db,table);
+
+				// Drop the fully delivered partitions, the current one receives the inserts.
+				for(size_t ix = 0; ix+1 < partitions.size(); ix++) {
+
+					const Partition &partition = partitions[ix];
+					int64_t from = partition.base;
+					int64_t to = partitions[ix+1].base;
+
+					int64_t count = integer(db,string{"select count(*) from \""} + partition.name + "\"");
+					int64_t sent = integer(db,string{"select count(*) from "} + delivered + " where id > ?1 and id <= ?2",{from,to});
+
+					if(count != sent) {
+						continue;
+					}
+
+					info() << "Dropping delivered partition '" << partition.name << "' (" << count << " message(s))" << endl;
+
+					db->exec((string{"drop table \""} + partition.name + "\"").c_str());
+					Statement(db,(string{"delete from "} + delivered + " where id > ?1 and id <= ?2").c_str()).bind(1,from).bind(2,to).exec();
+					Statement(db,"delete from udjat_partitions where tbl=? and name=?").bind(1,string{table}).bind(2,partition.name).exec();
+					changed = true;
+
+				}
+
+				// Start a new partition when the current one is full or old.
+				const Partition &current = partitions.back();
+				string key{key_of(columns_of(db,current.name),current.name)};
+				int64_t count = integer(db,string{"select count(*) from \""} + current.name + "\"");
+
+				if(count && ((interval && (time(0) - current.created) >= interval) || (rows && ((size_t) count) >= rows))) {
+
+					int64_t base = integer(db,string{"select max(\""} + key + "\") from \"" + current.name + "\"");
+					string name{string{table} + "_" + std::to_string(base)};
+
+					string sql;
+					{
+						Statement select(db,"select sql from sqlite_master where type='table' and name=?");
+						select.bind(1,current.name);
+						if(select.step() == SQLITE_ROW) {
+							select.get(0,sql);
+						}
+						select.reset();
+					}
+
+					size_t definition = sql.find('(');
+					if(definition == string::npos) {
+						throw runtime_error(string{"Can't get definition of partition '"} + current.name + "'");
+					}
+
+					info() << "Starting partition '" << name << "' on queue '" << table << "'" << endl;
+
+					db->exec((string{"create table \""} + name + "\" " + sql.substr(definition)).c_str());
+					Statement(db,"insert into udjat_partitions (tbl,name,base,created) values (?,?,?,?)")
+						.bind(1,string{table})
+						.bind(2,name)
+						.bind(3,base)
+						.bind(4,(int64_t) time(0))
+						.exec();
+					changed = true;
+
+				}
+
+				if(changed) {
+					build(db,table);
+				}
+
+				transaction.commit();
+			}
+
+			if(changed) {
+				listen(db,table);
+			}
+
+		}
+
+	}
+
+ }
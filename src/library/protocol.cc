@@ -34,6 +34,12 @@
  #include <udjat/tools/threadpool.h>
  #include <udjat/tools/intl.h>
  #include <string>
+ #include <cstring>
+ #include <cctype>
+ #include <cstdio>
+ #include <vector>
+ #include <future>
+ #include <algorithm>
 
 #ifndef _WIN32
 	#include <unistd.h>
@@ -58,12 +64,74 @@
 		return Quark(sql).c_str();
 	}
 
+	/// @brief Get shard for the destination of url.
+	/// @details The destination is the URL authority, all requests to it
+	///          are queued on the same shard keeping their order.
+	static size_t shard(const char *url, size_t shards) {
+
+		if(shards < 2) {
+			return 0;
+		}
+
+		const char *authority = strstr(url,"://");
+		authority = (authority ? authority+3 : url);
+		size_t length = strcspn(authority,"/?#");
+
+		// FNV-1a, the same as payload_hash().
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for(size_t ix = 0; ix < length; ix++) {
+			hash ^= (unsigned char) tolower(authority[ix]);
+			hash *= 0x100000001b3ULL;
+		}
+
+		return (size_t) (hash % shards);
+	}
+
+	/// @brief Get the file name for shard, 'dbname.db' is split on 'dbname-1.db', 'dbname-2.db', ...
+	static std::string shard_filename(const SQLite::Database &database, size_t shard) {
+
+		string filename{database.filename()};
+		if(filename.empty()) {
+			throw runtime_error("Sharded queues requires a database file");
+		}
+
+		size_t dot = filename.rfind('.');
+		size_t separator = filename.find_last_of("/\\");
+		if(dot == string::npos || (separator != string::npos && dot < separator)) {
+			dot = filename.size();
+		}
+
+		filename.insert(dot,string{"-"} + std::to_string(shard));
+		return filename;
+	}
+
+	std::vector<std::shared_ptr<SQLite::Database>> SQLite::Protocol::databases() const {
+		std::vector<std::shared_ptr<Database>> databases;
+		lock_guard<mutex> lock(guard);
+		for(const Shard &shard : shards) {
+			databases.push_back(shard.database);
+		}
+		return databases;
+	}
+
+	std::shared_ptr<SQLite::Database> SQLite::Protocol::route(const char *url) const {
+		lock_guard<mutex> lock(guard);
+		if(shards.empty()) {
+			return database;
+		}
+		return shards[shard(url,shards.size())].database;
+	}
+
 	int64_t SQLite::Protocol::count() const {
 		int64_t pending_messages = 0;
 		if(pending && *pending) {
-			Statement sql{database,pending};
-			sql.step();
-			sql.get(0,pending_messages);
+			for(auto db : databases()) {
+				// Cached by the database until the queue table changes.
+				auto result = db->fetch(pending);
+				if(!result->rows.empty() && !result->rows[0].empty() && !result->rows[0][0].empty()) {
+					pending_messages += stoll(result->rows[0][0]);
+				}
+			}
 		}
 		return pending_messages;
 	}
@@ -72,30 +140,397 @@
 
 	SQLite::Protocol::Protocol(	std::shared_ptr<Database> db, const pugi::xml_node &node) :
 		Udjat::Protocol{Quark(node,"name","sql",false).c_str(),moduleinfo},
-		database{db},
-		ins{child_value(node,"insert")},
-		del{child_value(node,"delete")},
-		select{child_value(node,"select")},
-		list{child_value(node,"report",false)},
-		pending{child_value(node,"pending",false)} {
+		database{db} {
+
+		reload(node);
+
+	}
+
+	void SQLite::Protocol::reload(const pugi::xml_node &node) {
+
+		// A destination is mapped to a shard by the number of shards, it can only
+		// change while the queue is empty or the requests would be sent out of order.
+		std::vector<std::shared_ptr<Database>> databases = this->databases();
+		size_t active = databases.size();
+		if(databases.empty()) {
+			databases.push_back(database);
+		}
+
+		database->exec("create table if not exists udjat_shards (name text primary key, shards integer not null)");
+
+		size_t previous = active;
+		if(!previous) {
+			// Number of shards on the last run.
+			int64_t shards = 1;
+			Statement select(database,"select shards from udjat_shards where name=?");
+			select.bind(1,Protocol::c_str());
+			if(select.step() == SQLITE_ROW) {
+				select.get(0,shards);
+			}
+			select.reset();
+			previous = (size_t) (shards > 0 ? shards : 1);
+		}
+
+		size_t count = Object::getAttribute(node, "sqlite", "shards", (unsigned int) previous);
+		if(!count) {
+			count = 1;
+		}
+
+		// Open the old shards too, they are checked before changing the number of shards.
+		while(databases.size() < std::max(count,previous)) {
+			string filename{shard_filename(*database,databases.size())};
+			info() << "Opening queue shard '" << filename << "'" << endl;
+			databases.push_back(make_shared<Database>(filename.c_str()));
+		}
+
+		// The queue schema is changed and the new statements prepared on one transaction
+		// by shard, committed only when everything is valid.
+		std::vector<std::unique_ptr<Database::Transaction>> transactions;
+		for(auto db : databases) {
+
+			transactions.emplace_back(new Database::Transaction{db});
+
+			for(pugi::xml_node child = node.child("init"); child; child = child.next_sibling("init")) {
+
+				String sql{child.child_value()};
+				sql.strip();
+				sql.expand(child);
+
+				debug(sql.c_str());
+
+				db->exec(sql.c_str());
+
+			}
+
+		}
+
+		const char *table = Quark(node.attribute("table").as_string()).c_str();
+
+		time_t partition_interval = Object::getAttribute(node, "sqlite", "partition-interval", (unsigned int) 0);
+		size_t partition_rows = Object::getAttribute(node, "sqlite", "partition-rows", (unsigned int) 0);
+
+		string key;
+		if(partition_interval || partition_rows) {
+			if(!*table) {
+				throw runtime_error("Partitioned queues requires the queue 'table'");
+			}
+			if(node.child("column") || *node.attribute("search").as_string()) {
+				throw runtime_error("Indexed columns and search are not available on partitioned queues");
+			}
+			for(auto db : databases) {
+				key = partitions(db,table);
+			}
+		}
+
+		size_t batch = Object::getAttribute(node, "sqlite", "send-batch", (unsigned int) 1);
+
+		bool watermark = false;
+		{
+			const char *mode = node.attribute("acknowledge").as_string("row");
+			if(!strcmp(mode,"watermark")) {
+				watermark = true;
+			} else if(strcmp(mode,"row")) {
+				throw runtime_error(string{"Invalid acknowledge mode '"} + mode + "'");
+			}
+		}
+
+		const char *pending = child_value(node,"pending",false);
+		const char *ins = child_value(node,"insert");
+		const char *del;
+		const char *select;
+		const char *skip = nullptr;
+		const char *advance = nullptr;
+
+		string exceptions{string{table} + "_exceptions"};
+		string delivered{string{"(select delivered from udjat_watermarks where tbl='"} + table + "')"};
+
+		if(watermark) {
+
+			if(!*table) {
+				throw runtime_error("Watermark acknowledge requires the queue 'table'");
+			}
+			if(!key.empty()) {
+				throw runtime_error("Watermark acknowledge is not available on partitioned queues");
+			}
+
+			for(auto db : databases) {
+				watermarks(db,table);
+			}
+
+			// Retry the exceptions first, then continue after the watermark.
+			select = Quark(
+				string{"select * from (select rowid,url,action,payload from "} + table + " where rowid in (select id from " + exceptions + ") order by rowid limit 1) "
+				"union all "
+				"select * from (select rowid,url,action,payload from " + table + " where rowid > " + delivered + " order by rowid limit 1) "
+				"limit 1"
+			).c_str();
+
+			del = Quark(string{"delete from "} + exceptions + " where id=?1").c_str();
+			skip = Quark(string{"insert or ignore into "} + exceptions + " (id) select rowid from " + table + " where rowid > " + delivered + " and rowid < ?1").c_str();
+			advance = Quark(string{"update udjat_watermarks set delivered=?1 where tbl='"} + table + "' and delivered < ?1").c_str();
+
+			// Acknowledged rows are kept until purged, don't count them.
+			pending = Quark(
+				string{"select (select count(*) from "} + table + " where rowid > " + delivered + ") + (select count(*) from " + exceptions + ")"
+			).c_str();
+
+		} else {
+
+			del = child_value(node,"delete");
+
+			if(batch > 1) {
+				// Batches are read by key, a custom order would be ignored.
+				if(node.child("select")) {
+					throw runtime_error("Pipelined send reads the queue in key order, remove the 'select' child or the 'send-batch' attribute");
+				}
+				select = nullptr;
+			} else {
+				select = child_value(node,"select");
+			}
+
+		}
+
+		size_t capture = Object::getAttribute(node, "sqlite", "response-capture", (unsigned int) 0);
+		unsigned int sample = Object::getAttribute(node, "sqlite", "log-sample", (unsigned int) 1);
+		size_t concurrency = Object::getAttribute(node, "sqlite", "max-concurrency", (unsigned int) 1);
+
+		// Undelivered rows, on watermark queues the ones below it are delivered unless they are exceptions.
+		string id{key.empty() ? "rowid" : key};
+		string filter;
+		if(watermark) {
+			filter = string{"("} + id + " > " + delivered + " or " + id + " in (select id from " + exceptions + "))";
+		}
+
+		const char *fetch = nullptr;
+		if(batch > 1) {
+
+			if(!*table) {
+				throw runtime_error("Pipelined send requires the queue 'table'");
+			}
+
+			// Keyset on the queue order, the batch in flight isn't deleted yet.
+			fetch = Quark(
+				string{"select "} + id + ",url,action,payload from " + table + " where " + id + " > ?1" + (filter.empty() ? "" : " and ") + filter + " order by " + id + " limit ?2"
+			).c_str();
+
+			if(!select) {
+				// Only checks for pending requests, on the same order.
+				select = Quark(string{"select "} + id + ",url,action,payload from " + table + " order by " + id + " limit 1").c_str();
+			}
+
+		} else {
+			batch = 1;
+		}
+
+		const char *heads = nullptr;
+		if(concurrency > 1) {
+
+			if(!*table) {
+				throw runtime_error("Parallel send requires the queue 'table'");
+			}
+
+			if(batch > 1) {
+				throw runtime_error("The 'send-batch' and 'max-concurrency' attributes can't be used together");
+			}
+
+			string ordering{node.attribute("ordering-key").as_string(id.c_str())};
+
+			if(key.empty() && ordering != id) {
+				// Views can't be indexed, on tables the index keeps the head lookup on the keys.
+				string index{string{"create index "} + table + "_ordering on " + table + " (" + ordering + ")"};
+				for(auto db : databases) {
+
+					string sql;
+					{
+						Statement select(db,"select sql from sqlite_master where type='index' and name=?");
+						select.bind(1,string{table} + "_ordering");
+						if(select.step() == SQLITE_ROW) {
+							select.get(0,sql);
+						}
+						select.reset();
+					}
+
+					if(sql != index) {
+						db->exec((string{"drop index if exists "} + table + "_ordering").c_str());
+						db->exec(index.c_str());
+					}
+
+				}
+			}
+
+			string where{filter.empty() ? "" : string{" where "} + filter};
+			heads = Quark(
+				string{"select "} + id + ",url,action,payload,(" + ordering + ") from " + table + " "
+				"where " + id + " in (select min(" + id + ") from " + table + where + " group by (" + ordering + "))" + (filter.empty() ? "" : " and ") + filter + " "
+				"order by " + id + " limit ?1"
+			).c_str();
+
+		} else {
+			concurrency = 1;
+		}
+
+		// Failed requests, arguments are URL, VERB, Payload and status.
+		const char *dead = child_value(node,"dead-letter",false);
+		if(!*dead && *table) {
+			for(auto db : databases) {
+				db->exec((
+					string{"create table if not exists "} + table + "_dead (id integer primary key, failed timestamp default CURRENT_TIMESTAMP, url text, action text, payload text, status integer)"
+				).c_str());
+			}
+			dead = Quark(string{"insert into "} + table + "_dead (url,action,payload,status) values (?,?,?,?)").c_str();
+		}
+
+		std::vector<std::shared_ptr<Database>> surplus;
+		if(count != previous) {
+
+			string sql{pending};
+			if(sql.empty()) {
+				if(!*table) {
+					throw runtime_error("Changing the number of shards requires the queue 'table' or the 'pending' query");
+				}
+				sql = string{"select count(*) from "} + table;
+			}
+
+			for(auto db : databases) {
+				int64_t requests = 0;
+				Statement select(db,sql.c_str());
+				if(select.step() == SQLITE_ROW) {
+					select.get(0,requests);
+				}
+				select.reset();
+				if(requests) {
+					throw runtime_error(
+						string{"The number of shards can't change from "} + std::to_string(previous) + " to " + std::to_string(count)
+						+ " with " + std::to_string(requests) + " request(s) queued on '" + db->filename() + "', wait for the queue to drain"
+					);
+				}
+			}
+
+			info() << "Changing the number of queue shards from " << previous << " to " << count << endl;
+
+			// The surplus shards are dropped only after the commit, they are still active if the reload fails.
+			surplus.assign(databases.begin()+count,databases.end());
+			databases.resize(count);
+
+		}
+
+		// Prepare before swapping, if the SQL is invalid the active statements are kept.
+		std::vector<Shard> shards;
+		for(auto db : databases) {
+			shards.push_back({
+				db,
+				make_shared<Statement>(db,select),
+				make_shared<Statement>(db,del),
+				(skip ? make_shared<Statement>(db,skip) : nullptr),
+				(advance ? make_shared<Statement>(db,advance) : nullptr),
+				(fetch ? make_shared<Statement>(db,fetch) : nullptr),
+				(*dead ? make_shared<Statement>(db,dead) : nullptr),
+				(heads ? make_shared<Statement>(db,heads) : nullptr)
+			});
+			Statement{db,ins};
+		}
+
+		time_t send_delay = Object::getAttribute(node, "sqlite", "retry-delay", (unsigned int) this->send_delay);
+		time_t backoff_max = Object::getAttribute(node, "sqlite", "retry-max-delay", (unsigned int) backoff.max);
+		if(*table) {
+			for(auto db : databases) {
+				columns(db,table,node);
+			}
+		} else if(node.child("column")) {
+			throw runtime_error("Indexed columns requires the queue 'table'");
+		}
 
-		send_delay = Object::getAttribute(node, "sqlite", "retry-delay", (unsigned int) send_delay);
+		const char *search_sql = "";
+		{
+			const char *column = node.attribute("search").as_string();
+			if(*column) {
+				if(!*table) {
+					throw runtime_error("The 'search' attribute requires the queue 'table'");
+				}
+				for(auto db : databases) {
+					index(db,table,column);
+				}
+				search_sql = Quark(
+					string{"select "} + table + ".* from " + table + "_fts join " + table + " on " + table + ".rowid = " + table + "_fts.rowid "
+					"where " + table + "_fts match ?1 order by " + table + ".rowid"
+				).c_str();
+			}
+		}
 
-		for(pugi::xml_node child = node.child("init"); child; child = child.next_sibling("init")) {
+		const char *dump_sql = child_value(node,"export",false);
+		if(!*dump_sql && *table) {
+			// Views have no rowid, partitioned queues are paged by their key.
+			const char *id = (key.empty() ? "rowid" : key.c_str());
+			dump_sql = Quark(string{"select "} + id + ",url,action,payload from " + table + " where " + id + " > ?1" + (filter.empty() ? "" : " and ") + filter + " order by " + id + " limit ?2").c_str();
+		}
 
-			String sql{child.child_value()};
-			sql.strip();
-			sql.expand(child);
+		size_t max_rows = Object::getAttribute(node, "sqlite", "report-max-rows", (unsigned int) limits.rows);
+		time_t max_time = Object::getAttribute(node, "sqlite", "report-timeout", (unsigned int) limits.time);
 
-			debug(sql.c_str());
+		Policy policy = policies(node);
 
-			database->exec(sql.c_str());
+		Statement(database,"insert or replace into udjat_shards (name,shards) values (?,?)").bind(1,Protocol::c_str()).bind(2,(int64_t) count).exec();
 
+		for(auto &transaction : transactions) {
+			transaction->commit();
+		}
+		transactions.clear();
+
+		for(auto db : surplus) {
+			db->remove(this);
+		}
+
+		for(size_t ix = 0; ix < databases.size(); ix++) {
+			if(!key.empty()) {
+				listen(databases[ix],table);
+			} else if(ix >= active || strcmp(table,this->table)) {
+				databases[ix]->remove(this);
+				if(*table) {
+					// Refresh on any committed change, including the ones not made by this protocol.
+					databases[ix]->insert(this,table,[this](const char *) {
+						refresh();
+					});
+				}
+			}
+		}
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			this->ins = ins;
+			this->del = del;
+			this->select = select;
+			this->list = child_value(node,"report",false);
+			this->pending = pending;
+			this->send_delay = send_delay;
+			this->backoff.max = backoff_max;
+			this->table = table;
+			this->search_sql = search_sql;
+			this->dump_sql = dump_sql;
+			this->limits.rows = max_rows;
+			this->limits.time = max_time;
+			this->partition.interval = partition_interval;
+			this->partition.rows = partition_rows;
+			this->watermark = watermark;
+			this->batch = batch;
+			this->concurrency = concurrency;
+			this->capture = capture;
+			this->sample = (sample ? sample : 1);
+			this->policy = policy;
+
+			// The previous statements are finalized when the last sender releases them.
+			this->shards = shards;
+			if(next >= shards.size()) {
+				next = 0;
+			}
 		}
 
 	}
 
 	SQLite::Protocol::~Protocol() {
+		for(auto db : databases()) {
+			db->remove(this);
+		}
 		if(busy) {
 			info() << "Waiting for workers" << endl;
 			ThreadPool::getInstance().wait();
@@ -181,12 +616,253 @@
 		return make_shared<Abstract::State>("none", Level::unimportant, _( "No pending requests") );
 	}
 
+	static const char * event_names[] = { "send", "ack" };
+
+	void SQLite::Protocol::event(Logger::Level level, Event id, const Message &message) const {
+
+		if(!Logger::enabled(level)) {
+			return;
+		}
+
+		unsigned int sample = this->sample;
+		if(sample > 1 && (events[id]++ % sample)) {
+			return;
+		}
+
+		char buffer[512];
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"%s id=%lld action=%s url=%s",
+			event_names[id],
+			(long long) message.id,
+			message.action.c_str(),
+			message.url.c_str()
+		);
+
+		Logger::write(level,Protocol::c_str(),buffer);
+
+	}
+
+	bool SQLite::Protocol::deliver(const Message &message) {
+
+		event(Logger::Info,Sent,message);
+		if(Logger::enabled(Logger::Trace)) {
+			Logger::write(Logger::Trace,Protocol::c_str(),message.payload.c_str());
+		}
+
+		HTTP::Method method = HTTP::MethodFactory(message.action.c_str());
+		if(method != HTTP::Get && method != HTTP::Post) {
+			error() << "Unexpected verb '" << message.action << "' sending queued request, ignoring" << endl;
+			return false;
+		}
+
+		// The worker for the destination scheme, as used by HTTP::Client.
+		auto worker = Udjat::Protocol::WorkerFactory(message.url.c_str());
+		if(!worker) {
+			throw runtime_error(string{"Can't handle '"} + message.url + "'");
+		}
+
+		worker->method(method);
+		if(method == HTTP::Post) {
+			worker->payload(message.payload.c_str());
+		}
+
+		// Only the captured part of the response is kept.
+		Logger::Level level = Logger::Info;
+		size_t limit = capturing(level);
+
+		std::string body;
+		size_t length = 0;
+
+		// Streamed, the body beyond the limit is never stored.
+		worker->save([&body,&length,limit](unsigned long long, unsigned long long, const void *buf, size_t bytes) {
+			if(body.size() < limit) {
+				body.append((const char *) buf,std::min(bytes,limit - body.size()));
+			}
+			length += bytes;
+			return true;
+		});
+
+		if(limit) {
+			received(message,level,body,length);
+		}
+
+		return true;
+
+	}
+
+	size_t SQLite::Protocol::capturing(Logger::Level &level) const {
+
+		size_t limit;
+		{
+			lock_guard<mutex> lock(guard);
+			limit = capture;
+		}
+
+		level = Logger::Info;
+		if(!limit && Logger::enabled(Logger::Trace)) {
+			level = Logger::Trace;
+			limit = 4096;
+		}
+
+		return limit;
+
+	}
+
+	void SQLite::Protocol::received(const Message &message, Logger::Level level, const std::string &body, size_t length) const {
+
+		std::string text{string{"Response to "} + std::to_string(message.id) + ": " + body};
+		if(length > body.size()) {
+			text += "... (";
+			text += std::to_string(length);
+			text += " bytes)";
+		}
+
+		Logger::write(level,Protocol::c_str(),text.c_str());
+
+	}
+
+	void SQLite::Protocol::acknowledge(const Shard &shard, const std::vector<int64_t> &ids, const std::vector<Letter> &letters) {
+
+		// The transaction also serializes the senders on the shard statements.
+		Database::Transaction transaction{shard.database};
+
+		// Buried and removed together, a failure keeps the request queued and not buried.
+		for(const Letter &letter : letters) {
+			bury(shard,letter.message,letter.status);
+		}
+
+		for(int64_t id : ids) {
+
+			// Delete the row or, with a watermark, the delivered exception.
+			shard.del->reset();
+			size_t changes = shard.del->bind(1,id).exec();
+			shard.del->reset();
+
+			if(changes || !shard.advance) {
+				continue;
+			}
+
+			// Rows skipped by an out of order delivery are kept as exceptions.
+			shard.skip->reset();
+			shard.skip->bind(1,id).exec();
+			shard.skip->reset();
+
+			shard.advance->reset();
+			shard.advance->bind(1,id).exec();
+			shard.advance->reset();
+
+		}
+
+		transaction.commit();
+
+	}
+
+	bool SQLite::Protocol::pipeline(const Shard &shard) {
+
+		size_t size;
+		{
+			lock_guard<mutex> lock(guard);
+			size = batch;
+		}
+
+		auto fetch = [&shard,size](int64_t after) {
+			std::vector<Message> messages;
+			Statement &select = *shard.fetch;
+			select.reset();
+			select.bind(1,after).bind(2,(int64_t) size);
+			while(select.step() == SQLITE_ROW) {
+				messages.emplace_back();
+				select.get(0,messages.back().id);
+				select.get(1,messages.back().url);
+				select.get(2,messages.back().action);
+				select.get(3,messages.back().payload);
+			}
+			select.reset();
+			return messages;
+		};
+
+		size_t sent = 0;
+		std::future<void> acked;
+
+		std::vector<Message> messages = fetch(0);
+
+		while(!messages.empty()) {
+
+			// Read batch K+1 while batch K is on the network.
+			auto ahead = std::async(std::launch::async,fetch,messages.back().id);
+
+			std::vector<int64_t> delivered;
+			std::vector<Letter> letters;
+			bool failed = false;
+
+			for(const Message &message : messages) {
+
+				if(!(MainLoop::getInstance() && Protocol::verify(this))) {
+					failed = true;
+					break;
+				}
+
+				int status;
+				Action action = dispatch(message,status);
+
+				if(action == Retry) {
+					failed = true;
+					break;
+				}
+
+				if(action == DeadLetter) {
+					letters.push_back({message,status});
+				}
+
+				delivered.push_back(message.id);
+
+			}
+
+			// Batch K-1 acknowledged before K, the watermark only moves forward.
+			if(acked.valid()) {
+				acked.get();
+			}
+
+			if(!delivered.empty()) {
+				sent += delivered.size();
+				info() << "Removing " << delivered.size() << " request(s) from URL queue" << endl;
+				acked = std::async(std::launch::async,[this,&shard,delivered,letters]() {
+					acknowledge(shard,delivered,letters);
+				});
+			}
+
+			auto next = ahead.get();
+			if(failed) {
+				break;
+			}
+			messages = std::move(next);
+
+		}
+
+		if(acked.valid()) {
+			acked.get();
+		}
+
+		return sent > 0;
+
+	}
+
 	bool SQLite::Protocol::send() noexcept {
 
 		size_t success = false;
 
 		debug("start ", __FUNCTION__);
 
+		{
+			lock_guard<mutex> lock(this->guard);
+			if(time(0) < backoff.until) {
+				debug("Waiting ",(backoff.until - time(0))," seconds before retry");
+				return false;
+			}
+		}
+
 		static mutex guard;
 
 		{
@@ -198,66 +874,104 @@
 			busy = true;
 		}
 
+		std::vector<Shard> shards;
+		size_t first;
+		{
+			lock_guard<mutex> lock(this->guard);
+			shards = this->shards;
+			first = next;
+		}
+
+		shared_ptr<Statement> select, del;
+		const Shard *current = nullptr;
+
 		try {
 
-			Statement del(database,this->del);
-			Statement select(database,this->select);
+			maintain();
+
 			MainLoop &mainloop = MainLoop::getInstance();
 
-			if(select.step() == SQLITE_ROW && mainloop && Protocol::verify(this)) {
+			// Round robin, start on the shard after the last one sent.
+			for(size_t ix = 0; ix < shards.size() && !select; ix++) {
 
-				int64_t id;
-				Udjat::URL url;
-				string action, payload;
+				const Shard &shard = shards[(first+ix) % shards.size()];
 
-				select.get(0,id);
-				select.get(1,url);
-				select.get(2,action);
-				select.get(3,payload);
+				shard.select->reset();
+				if(shard.select->step() == SQLITE_ROW) {
+					select = shard.select;
+					del = shard.del;
+					current = &shard;
+					lock_guard<mutex> lock(this->guard);
+					next = (first+ix+1) % shards.size();
+				} else {
+					shard.select->reset();
+				}
 
-				info() << "Sending " << action << " " << url << " (" << id << ")" << endl;
-				Logger::write(Logger::Trace,Protocol::c_str(),payload.c_str());
+			}
 
-				HTTP::Client client(url);
+			if(select && current->fetch) {
 
-				switch(HTTP::MethodFactory(action.c_str())) {
-				case HTTP::Get:
-					{
-						auto response = client.get();
-						info() << url << endl;
-						Logger::write(Logger::Trace,response);
-						success = true;
-					}
-					break;
+				// The first row is read again with the batch.
+				select->reset();
+				if(mainloop && Protocol::verify(this)) {
+					success = pipeline(*current);
+				}
 
-				case HTTP::Post:
-					{
-						auto response = client.post(payload.c_str());
-						Logger::write(Logger::Trace,response);
-						success = true;
-					}
-					break;
+			} else if(select && current->heads) {
 
-				default:
-					error() << "Unexpected verb '" << action << "' sending queued request, ignoring" << endl;
-					success = false;
+				select->reset();
+				if(mainloop && Protocol::verify(this)) {
+					success = parallel(*current);
 				}
 
-				info() << "Removing request '" << id << "' from URL queue" << endl;
-				del.bind(1,id).exec();
+			} else if(select && mainloop && Protocol::verify(this)) {
 
-				del.reset();
-				select.reset();
+				Message message;
+
+				select->get(0,message.id);
+				select->get(1,message.url);
+				select->get(2,message.action);
+				select->get(3,message.payload);
 
+				// Don't keep the read transaction open while the request is on the network.
+				select->reset();
+
+				int status;
+				Action action = dispatch(message,status);
+
+				if(action != Retry) {
+					std::vector<Letter> letters;
+					if(action == DeadLetter) {
+						letters.push_back({message,status});
+					}
+					event(Logger::Info,Acknowledged,message);
+					acknowledge(*current,{message.id},letters);
+				}
+
+				// A dead letter left the queue too, as on the batch and parallel sends.
+				success = (action != Retry);
+
+			}
+
+			if(select) {
+				select->reset();
 			}
 
 		} catch(const std::exception &e) {
 
+			if(select) {
+				select->reset();
+				del->reset();
+			}
 			warning() << "Error sending queued message: " << e.what() << endl;
 			success = false;
 
 		} catch(...) {
 
+			if(select) {
+				select->reset();
+				del->reset();
+			}
 			warning() << "Unexpected error sending queued messages" << endl;
 			success = false;
 
@@ -299,8 +1013,8 @@
 				String sql{this->sql};
 				sql.expand(true,true);
 
-				// Prepare.
-				Statement stmt(protocol->database,sql.c_str());
+				// Prepare on the destination shard.
+				Statement stmt(protocol->route(url().c_str()),sql.c_str());
 
 				// Arguments: URL, VERB, Payload
 				stmt.bind(
@@ -312,7 +1026,8 @@
 
 				stmt.exec();
 
-				{
+				if(!*protocol->table) {
+					// Without a table the update hook can't refresh the listeners.
 					Protocol *prot = const_cast<Protocol *>(this->protocol);
 					if(prot) {
 						prot->refresh();
@@ -340,18 +1055,535 @@
 
 		};
 
+		lock_guard<mutex> lock(guard);
 		return make_shared<Worker>(this,ins);
 	}
 
 	void SQLite::Protocol::get(Report &report) {
 
-		if(!list[0]) {
+		const char *sql;
+		size_t max_rows;
+		time_t max_time;
+		{
+			lock_guard<mutex> lock(guard);
+			sql = list;
+			max_rows = limits.rows;
+			max_time = limits.time;
+		}
+
+		if(!(sql && *sql)) {
 			throw system_error(ENOENT,system_category(),_( "No available report in this path" ));
 		}
 
-		throw system_error(ENOTSUP,system_category(),_( "Not implemented" ));
+		// Only the configured query runs, on the read connection so the queue is not blocked.
+		size_t rows = 0;
+		auto databases = this->databases();
+		for(size_t ix = 0; ix < databases.size() && !(max_rows && rows >= max_rows); ix++) {
+			rows += databases[ix]->reader()->report(sql,report,(max_rows ? max_rows - rows : 0),max_time,{},ix == 0);
+		}
 	}
 
- }
+ 	void SQLite::Protocol::index(std::shared_ptr<Database> db, const char *table, const char *column) {
+
+		string fts{string{table} + "_fts"};
+
+		bool created;
+		{
+			Statement exists(db,"select count(*) from sqlite_master where name=?");
+			exists.bind(1,fts);
+			int64_t count = 0;
+			if(exists.step() == SQLITE_ROW) {
+				exists.get(0,count);
+			}
+			created = (count == 0);
+		}
+
+		// External content index, the triggers keep it in sync with the queue.
+		db->exec((string{"create virtual table if not exists "} + fts + " using fts5(" + column + ", content='" + table + "')").c_str());
+
+		db->exec((
+			string{"create trigger if not exists "} + fts + "_insert after insert on " + table + " begin "
+				"insert into " + fts + " (rowid," + column + ") values (new.rowid,new." + column + "); "
+			"end"
+		).c_str());
+
+		db->exec((
+			string{"create trigger if not exists "} + fts + "_delete after delete on " + table + " begin "
+				"insert into " + fts + " (" + fts + ",rowid," + column + ") values ('delete',old.rowid,old." + column + "); "
+			"end"
+		).c_str());
+
+		db->exec((
+			string{"create trigger if not exists "} + fts + "_update after update on " + table + " begin "
+				"insert into " + fts + " (" + fts + ",rowid," + column + ") values ('delete',old.rowid,old." + column + "); "
+				"insert into " + fts + " (rowid," + column + ") values (new.rowid,new." + column + "); "
+			"end"
+		).c_str());
+
+		if(created) {
+			info() << "Indexing queued messages on '" << fts << "'" << endl;
+			db->exec((string{"insert into "} + fts + " (" + fts + ") values ('rebuild')").c_str());
+		}
+
+	}
+
+	void SQLite::Protocol::search(const char *terms, Report &report) {
+
+		const char *sql;
+		size_t max_rows;
+		time_t max_time;
+		{
+			lock_guard<mutex> lock(guard);
+			sql = search_sql;
+			max_rows = limits.rows;
+			max_time = limits.time;
+		}
+
+		if(!*sql) {
+			throw system_error(ENOENT,system_category(),_( "The queue has no search index" ));
+		}
+
+		size_t rows = 0;
+		auto databases = this->databases();
+		for(size_t ix = 0; ix < databases.size() && !(max_rows && rows >= max_rows); ix++) {
+			rows += databases[ix]->reader()->report(sql,report,(max_rows ? max_rows - rows : 0),max_time,{terms},ix == 0);
+		}
+
+	}
+
+ 	/// @brief Check SQL identifier.
+	static const char * identifier(const char *name) {
+		if(!*name) {
+			throw runtime_error("Required attribute 'name' not found in column definition");
+		}
+		for(const char *ptr = name; *ptr; ptr++) {
+			if(!(isalnum(*ptr) || *ptr == '_')) {
+				throw runtime_error(string{"Invalid column name '"} + name + "'");
+			}
+		}
+		return name;
+	}
+
+	void SQLite::Protocol::columns(std::shared_ptr<Database> db, const char *table, const pugi::xml_node &node) {
+
+		struct Column {
+			std::string name;
+			std::string path;
+		};
+
+		// Declared columns.
+		std::vector<Column> declared;
+		for(auto child = node.child("column"); child; child = child.next_sibling("column")) {
+			declared.push_back({
+				identifier(child.attribute("name").as_string()),
+				child.attribute("path").as_string()
+			});
+			if(declared.back().path.empty()) {
+				throw runtime_error(string{"Required attribute 'path' not found in column '"} + declared.back().name + "'");
+			}
+		}
+
+		const char *source = identifier(node.attribute("json-source").as_string("payload"));
+
+		db->exec(
+			"create table if not exists udjat_columns ("
+				"tbl text not null, "
+				"name text not null, "
+				"path text not null, "
+				"primary key (tbl,name)"
+			") without rowid"
+		);
+
+		Database::Transaction transaction{db};
+
+		// Columns created on previous runs.
+		std::vector<Column> active;
+		{
+			Statement select(db,"select name,path from udjat_columns where tbl=?");
+			select.bind(1,string{table});
+			while(select.step() == SQLITE_ROW) {
+				Column column;
+				select.get(0,column.name);
+				select.get(1,column.path);
+				active.push_back(column);
+			}
+			select.reset();
+		}
+
+		// Drop the removed or changed ones.
+		for(const Column &column : active) {
+
+			bool keep = false;
+			for(const Column &d : declared) {
+				if(d.name == column.name && d.path == column.path) {
+					keep = true;
+				}
+			}
+
+			if(keep) {
+				continue;
+			}
+
+			info() << "Removing indexed column '" << column.name << "' from '" << table << "'" << endl;
+			db->exec((string{"drop index if exists "} + table + "_" + column.name).c_str());
+			db->exec((string{"alter table "} + table + " drop column " + column.name).c_str());
+			Statement(db,"delete from udjat_columns where tbl=? and name=?").bind(1,string{table}).bind(2,column.name).exec();
+
+		}
+
+		// Create the new ones, virtual since sqlite can't add stored columns to an existing table,
+		// the index keeps the extracted value so selection doesn't parse the JSON.
+		Statement exists(db,"select count(*) from pragma_table_xinfo(?) where name=?");
+		for(const Column &column : declared) {
+
+			int64_t count = 0;
+			exists.reset();
+			exists.bind(1,string{table}).bind(2,column.name);
+			if(exists.step() == SQLITE_ROW) {
+				exists.get(0,count);
+			}
+			exists.reset();
+
+			if(count) {
+				continue;
+			}
+
+			string path{column.path};
+			for(size_t pos = path.find('\''); pos != string::npos; pos = path.find('\'',pos+2)) {
+				path.insert(pos,1,'\'');
+			}
+
+			info() << "Adding indexed column '" << column.name << "' (" << column.path << ") to '" << table << "'" << endl;
+			db->exec((
+				string{"alter table "} + table + " add column " + column.name + " generated always as "
+					"(case when json_valid(" + source + ") then json_extract(" + source + ",'" + path + "') end) virtual"
+			).c_str());
+			db->exec((string{"create index if not exists "} + table + "_" + column.name + " on " + table + " (" + column.name + ")").c_str());
+			Statement(db,"insert or replace into udjat_columns (tbl,name,path) values (?,?,?)").bind(1,string{table}).bind(2,column.name).bind(3,column.path).exec();
+
+		}
+
+		transaction.commit();
+
+	}
+
+ 	/// @brief Write field escaping the separators.
+	static void escape(std::ostream &out, const std::string &value) {
+		for(char chr : value) {
+			switch(chr) {
+			case '\\':
+				out << "\\\\";
+				break;
+			case '\t':
+				out << "\\t";
+				break;
+			case '\n':
+				out << "\\n";
+				break;
+			case '\r':
+				out << "\\r";
+				break;
+			default:
+				out << chr;
+			}
+		}
+	}
+
+	/// @brief Split dump line into unescaped fields.
+	static std::vector<std::string> unescape(const std::string &line) {
+
+		std::vector<std::string> fields(1);
+
+		for(size_t ix = 0; ix < line.size(); ix++) {
+
+			char chr = line[ix];
+
+			if(chr == '\t') {
+				fields.emplace_back();
+				continue;
+			}
+
+			if(chr == '\\' && ix+1 < line.size()) {
+				switch(line[++ix]) {
+				case 't':
+					chr = '\t';
+					break;
+				case 'n':
+					chr = '\n';
+					break;
+				case 'r':
+					chr = '\r';
+					break;
+				default:
+					chr = line[ix];
+				}
+			}
+
+			fields.back() += chr;
+
+		}
+
+		return fields;
+	}
+
+	size_t SQLite::Protocol::dump(std::ostream &out) {
+
+		const char *sql;
+		{
+			lock_guard<mutex> lock(guard);
+			sql = dump_sql;
+		}
+
+		if(!*sql) {
+			throw system_error(ENOENT,system_category(),_( "No export query, set the queue 'table'" ));
+		}
+
+		static const int64_t page = 500;
+
+		size_t rows = 0;
+
+		for(auto db : databases()) {
 
+			Statement select(db->reader(),sql);
+
+			int64_t last = 0;
+
+			// Keyset pagination, the read transaction is released after each page.
+			for(;;) {
+
+				size_t count = 0;
+
+				select.reset();
+				select.bind(1,last).bind(2,page);
+
+				std::string url, action, payload;
+				while(select.step() == SQLITE_ROW) {
+
+					select.get(0,last);
+					select.get(1,url);
+					select.get(2,action);
+					select.get(3,payload);
+
+					out << last << '\t';
+					escape(out,url);
+					out << '\t';
+					escape(out,action);
+					out << '\t';
+					escape(out,payload);
+					out << '\n';
+
+					count++;
+				}
+
+				select.reset();
+				rows += count;
+
+				if(count < (size_t) page) {
+					break;
+				}
+
+			}
+
+		}
+
+		out.flush();
+		return rows;
+
+	}
+
+	size_t SQLite::Protocol::load(std::istream &in) {
+
+		const char *sql, *table;
+		{
+			lock_guard<mutex> lock(guard);
+			sql = ins;
+			table = this->table;
+		}
+
+		/// @brief Load state by shard, the statement is finalized before the transaction ends.
+		struct Target {
+			std::shared_ptr<Database> database;
+			std::unique_ptr<Database::Transaction> transaction;
+			std::unique_ptr<Statement> insert;
+			std::vector<std::string> indexes;
+			std::vector<std::string> triggers;
+		};
+
+		std::vector<Target> targets;
+		for(auto db : databases()) {
+
+			targets.emplace_back();
+			Target &target = targets.back();
+
+			target.database = db;
+			target.transaction.reset(new Database::Transaction{db});
+
+			// Drop the queue indexes, they are rebuilt once after the inserts.
+			if(*table) {
+
+				Statement select(db,"select sql from sqlite_master where type='index' and tbl_name=? and sql is not null");
+				select.bind(1,string{table});
+
+				std::string index;
+				while(select.step() == SQLITE_ROW) {
+					select.get(0,index);
+					target.indexes.push_back(index);
+				}
+				select.reset();
+
+				Statement names(db,"select name from sqlite_master where type='index' and tbl_name=? and sql is not null");
+				names.bind(1,string{table});
+				std::vector<std::string> drop;
+				while(names.step() == SQLITE_ROW) {
+					names.get(0,index);
+					drop.push_back(index);
+				}
+				names.reset();
+
+				for(const std::string &name : drop) {
+					db->exec((string{"drop index \""} + name + "\"").c_str());
+				}
+
+				// The full text index triggers too, the index is rebuilt once at the end.
+				string prefix{string{table} + "_fts_"};
+				drop.clear();
+
+				Statement triggers(db,"select name,sql from sqlite_master where type='trigger' and tbl_name=?1 and substr(name,1,length(?2))=?2");
+				triggers.bind(1,string{table}).bind(2,prefix);
+				while(triggers.step() == SQLITE_ROW) {
+					triggers.get(0,index);
+					drop.push_back(index);
+					triggers.get(1,index);
+					target.triggers.push_back(index);
+				}
+				triggers.reset();
+
+				for(const std::string &name : drop) {
+					db->exec((string{"drop trigger \""} + name + "\"").c_str());
+				}
 
+			}
+
+			target.insert.reset(new Statement{db,sql});
+
+		}
+
+		size_t rows = 0;
+
+		std::string line;
+		while(std::getline(in,line)) {
+
+			if(line.empty()) {
+				continue;
+			}
+
+			auto fields = unescape(line);
+			if(fields.size() != 4) {
+				throw runtime_error(string{"Invalid line "} + std::to_string(rows+1) + " on queue dump");
+			}
+
+			// Arguments: URL, VERB, Payload; the id is assigned by the queue.
+			Statement &insert = *targets[shard(fields[1].c_str(),targets.size())].insert;
+			insert.reset();
+			insert.bind(
+				fields[1].c_str(),
+				fields[2].c_str(),
+				fields[3].c_str(),
+				nullptr
+			);
+			insert.exec();
+
+			rows++;
+
+		}
+
+		for(Target &target : targets) {
+
+			target.insert.reset();
+
+			for(const std::string &index : target.indexes) {
+				target.database->exec(index.c_str());
+			}
+
+			if(!target.triggers.empty()) {
+				for(const std::string &trigger : target.triggers) {
+					target.database->exec(trigger.c_str());
+				}
+				string fts{string{table} + "_fts"};
+				target.database->exec((string{"insert into "} + fts + " (" + fts + ") values ('rebuild')").c_str());
+			}
+
+			target.transaction->commit();
+
+		}
+
+		info() << "Imported " << rows << " request(s)" << endl;
+
+		return rows;
+
+	}
+
+	size_t SQLite::Protocol::enqueue(const std::vector<Entry> &entries) {
+
+		const char *sql;
+		bool listened;
+		{
+			lock_guard<mutex> lock(guard);
+			sql = ins;
+			listened = (*table != 0);
+		}
+
+		auto databases = this->databases();
+
+		// Group by shard first, the shards are then locked in index order as on load();
+		// locking them as the entries come could deadlock with other writers.
+		std::vector<std::vector<const Entry *>> groups(databases.size());
+		for(const Entry &entry : entries) {
+			groups[shard(entry.url.c_str(),groups.size())].push_back(&entry);
+		}
+
+		// Every shard is committed only after all the inserts, a failure leaves none of the batch.
+		std::vector<std::unique_ptr<Database::Transaction>> transactions;
+
+		for(size_t ix = 0; ix < groups.size(); ix++) {
+
+			if(groups[ix].empty()) {
+				continue;
+			}
+
+			transactions.emplace_back(new Database::Transaction{databases[ix]});
+
+			// Finalized before the transaction ends.
+			Statement insert{databases[ix],sql};
+
+			for(const Entry *entry : groups[ix]) {
+
+				// Arguments: URL, VERB, Payload
+				insert.reset();
+				insert.bind(
+					entry->url.c_str(),
+					entry->action.c_str(),
+					entry->payload.c_str(),
+					nullptr
+				);
+				insert.exec();
+
+			}
+
+		}
+
+		for(auto &transaction : transactions) {
+			transaction->commit();
+		}
+		transactions.clear();
+
+		if(!listened) {
+			// Without a table the update hook can't refresh the listeners.
+			refresh();
+		}
+
+		return entries.size();
+
+	}
+
+ }
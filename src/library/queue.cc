@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/sqlite/queue.h>
+ #include <udjat/sqlite/statement.h>
+ #include <cctype>
+ #include <iostream>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	SQLite::BasicQueue::BasicQueue(std::shared_ptr<Database> db, const char *name) : database{db}, table{string{"queue_"} + name} {
+
+		if(!*name) {
+			throw runtime_error("The queue name can't be empty");
+		}
+
+		for(const char *ptr = name; *ptr; ptr++) {
+			if(!(isalnum(*ptr) || *ptr == '_')) {
+				throw runtime_error(string{"Invalid queue name '"} + name + "'");
+			}
+		}
+
+		// Lease is the time when the entry is available again, 0 if not leased.
+		database->exec((
+			string{"create table if not exists "} + table + " ("
+				"id integer primary key, "
+				"enqueued integer not null, "
+				"lease integer not null default 0, "
+				"attempts integer not null default 0, "
+				"value blob"
+			")"
+		).c_str());
+
+		sql.insert = make_shared<Statement>(database,(string{"insert into "} + table + " (enqueued,value) values (?,?)").c_str());
+		sql.select = make_shared<Statement>(database,(string{"select id,attempts,value from "} + table + " where lease <= ?1 order by id limit ?2").c_str());
+		sql.lease = make_shared<Statement>(database,(string{"update "} + table + " set lease=?1, attempts=attempts+1 where id=?2").c_str());
+		sql.remove = make_shared<Statement>(database,(string{"delete from "} + table + " where id=?").c_str());
+		sql.release = make_shared<Statement>(database,(string{"update "} + table + " set lease=0 where id=?").c_str());
+		sql.rowid = make_shared<Statement>(database,"select last_insert_rowid()");
+
+	}
+
+	SQLite::BasicQueue::~BasicQueue() {
+	}
+
+	int64_t SQLite::BasicQueue::push_back(const std::string &value) {
+
+		lock_guard<mutex> lock(guard);
+
+		Database::Transaction transaction{database};
+
+		sql.insert->reset();
+		sql.insert->bind(1,(int64_t) time(0)).bind(2,value).exec();
+		sql.insert->reset();
+
+		int64_t id = 0;
+		sql.rowid->reset();
+		if(sql.rowid->step() == SQLITE_ROW) {
+			sql.rowid->get(0,id);
+		}
+		sql.rowid->reset();
+
+		transaction.commit();
+
+		return id;
+
+	}
+
+	size_t SQLite::BasicQueue::push_back(const std::vector<std::string> &values) {
+
+		lock_guard<mutex> lock(guard);
+
+		Database::Transaction transaction{database};
+
+		int64_t now = time(0);
+		for(const std::string &value : values) {
+			sql.insert->reset();
+			sql.insert->bind(1,now).bind(2,value).exec();
+		}
+		sql.insert->reset();
+
+		transaction.commit();
+
+		return values.size();
+
+	}
+
+	std::vector<SQLite::BasicQueue::Entry> SQLite::BasicQueue::lease(size_t max, time_t duration) {
+
+		std::vector<Entry> entries;
+		int64_t now = time(0);
+
+		lock_guard<mutex> lock(guard);
+
+		Database::Transaction transaction{database};
+
+		sql.select->reset();
+		sql.select->bind(1,now).bind(2,(int64_t) max);
+		while(sql.select->step() == SQLITE_ROW) {
+			int64_t attempts;
+			entries.emplace_back();
+			sql.select->get(0,entries.back().id);
+			sql.select->get(1,attempts);
+			sql.select->bytes(2,entries.back().value);
+			entries.back().attempts = (unsigned int) attempts + 1;
+		}
+		sql.select->reset();
+
+		for(const Entry &entry : entries) {
+			sql.lease->reset();
+			sql.lease->bind(1,now + (int64_t) duration).bind(2,entry.id).exec();
+		}
+		sql.lease->reset();
+
+		transaction.commit();
+
+		return entries;
+
+	}
+
+	void SQLite::BasicQueue::rejected(const Entry &entry, const char *reason) const {
+		cerr << "sqlite\tInvalid value on '" << table << "' entry " << entry.id << " (attempt " << entry.attempts << "): " << reason << endl;
+	}
+
+	void SQLite::BasicQueue::ack(const std::vector<int64_t> &ids) {
+
+		lock_guard<mutex> lock(guard);
+
+		Database::Transaction transaction{database};
+
+		for(int64_t id : ids) {
+			sql.remove->reset();
+			sql.remove->bind(1,id).exec();
+		}
+		sql.remove->reset();
+
+		transaction.commit();
+
+	}
+
+	void SQLite::BasicQueue::release(const std::vector<int64_t> &ids) {
+
+		lock_guard<mutex> lock(guard);
+
+		Database::Transaction transaction{database};
+
+		for(int64_t id : ids) {
+			sql.release->reset();
+			sql.release->bind(1,id).exec();
+		}
+		sql.release->reset();
+
+		transaction.commit();
+
+	}
+
+	/// @brief Get integer from query, cached by the database until the table changes.
+	static int64_t integer(std::shared_ptr<SQLite::Database> database, const std::string &sql) {
+		auto result = database->fetch(sql.c_str());
+		if(result->rows.empty() || result->rows[0].empty() || result->rows[0][0].empty()) {
+			return 0;
+		}
+		return stoll(result->rows[0][0]);
+	}
+
+	size_t SQLite::BasicQueue::size() {
+		return (size_t) integer(database,string{"select count(*) from "} + table);
+	}
+
+	size_t SQLite::BasicQueue::leased() {
+		// The time changes, not cached.
+		int64_t count = 0;
+		Statement select(database,(string{"select count(*) from "} + table + " where lease > ?").c_str());
+		select.bind(1,(int64_t) time(0));
+		if(select.step() == SQLITE_ROW) {
+			select.get(0,count);
+		}
+		select.reset();
+		return (size_t) count;
+	}
+
+	time_t SQLite::BasicQueue::age() {
+		int64_t enqueued = integer(database,string{"select enqueued from "} + table + " order by id limit 1");
+		return enqueued ? (time(0) - (time_t) enqueued) : 0;
+	}
+
+ }
@@ -0,0 +1,276 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/sqlite/replica.h>
+ #include <iostream>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+#ifdef HAVE_SQLITE_SESSION
+
+	/// @brief On conflict the primary wins, a change that can't be applied fails the changeset.
+	static int conflict_handler(void *, int reason, sqlite3_changeset_iter *iterator) {
+		switch(reason) {
+		case SQLITE_CHANGESET_DATA:
+		case SQLITE_CHANGESET_CONFLICT:
+			return SQLITE_CHANGESET_REPLACE;
+
+		case SQLITE_CHANGESET_NOTFOUND:
+			{
+				// A deleted row already missing on the standby is the same state.
+				const char *table = nullptr;
+				int columns = 0, operation = 0, indirect = 0;
+				if(sqlite3changeset_op(iterator,&table,&columns,&operation,&indirect) == SQLITE_OK && operation == SQLITE_DELETE) {
+					return SQLITE_CHANGESET_OMIT;
+				}
+			}
+			break;
+		}
+		return SQLITE_CHANGESET_ABORT;
+	}
+
+	SQLite::Replica::Replica(std::shared_ptr<Database> db, const char *f, const std::vector<std::string> &t) : database{db}, filename{f}, tables{t} {
+
+		if(tables.empty()) {
+			throw runtime_error("No tables to replicate");
+		}
+
+		sqlite3 *standby = nullptr;
+		if(sqlite3_open(filename.c_str(),&standby) != SQLITE_OK) {
+			string message{sqlite3_errmsg(standby)};
+			sqlite3_close(standby);
+			throw runtime_error(message);
+		}
+
+		try {
+
+			Database::functions(standby);
+
+			lock_guard<std::recursive_mutex> tlock(database->transaction);
+			lock_guard<std::mutex> lock(database->guard);
+
+			// Initial copy, the session starts from the same state.
+			cout << "sqlite\tCopying database to standby '" << filename << "'" << endl;
+			sqlite3_backup *backup = sqlite3_backup_init(standby,"main",database->db,"main");
+			if(!backup) {
+				throw runtime_error(sqlite3_errmsg(standby));
+			}
+			sqlite3_backup_step(backup,-1);
+			if(sqlite3_backup_finish(backup) != SQLITE_OK) {
+				throw runtime_error(sqlite3_errmsg(standby));
+			}
+
+			start();
+
+		} catch(...) {
+
+			sqlite3_close(standby);
+			throw;
+
+		}
+
+		thread = new std::thread([this,standby]() {
+
+			std::unique_lock<std::mutex> lock(guard);
+			while(enabled || !changesets.empty()) {
+
+				if(changesets.empty()) {
+					wakeup.wait(lock);
+					continue;
+				}
+
+				// Keep it queued while applying, lag is measured from the oldest one.
+				Changeset &changeset = changesets.front();
+				lock.unlock();
+
+				int rc = sqlite3changeset_apply(
+							standby,
+							(int) changeset.data.size(),
+							(void *) changeset.data.data(),
+							NULL,
+							conflict_handler,
+							NULL
+						);
+
+				lock.lock();
+
+				if(rc != SQLITE_OK) {
+
+					// The standby diverged, the next changesets can't be applied on it.
+					cerr << "sqlite\tError applying changeset to '" << filename << "': " << sqlite3_errstr(rc) << ", replication stopped until the standby is rebuilt" << endl;
+					failed = changeset.captured;
+					changesets.clear();
+					continue;
+
+				}
+
+				changesets.pop_front();
+
+			}
+
+			sqlite3_close(standby);
+
+		});
+
+	}
+
+	SQLite::Replica::~Replica() {
+
+		{
+			lock_guard<mutex> lock(guard);
+			enabled = false;
+		}
+		wakeup.notify_all();
+
+		thread->join();
+		delete thread;
+
+		lock_guard<std::mutex> lock(database->guard);
+		if(session) {
+			sqlite3session_delete(session);
+		}
+
+	}
+
+	void SQLite::Replica::start() {
+
+		if(sqlite3session_create(database->db,"main",&session) != SQLITE_OK) {
+			session = nullptr;
+			throw runtime_error(sqlite3_errmsg(database->db));
+		}
+
+		for(const std::string &table : tables) {
+			if(sqlite3session_attach(session,table.c_str()) != SQLITE_OK) {
+				sqlite3session_delete(session);
+				session = nullptr;
+				throw runtime_error(string{"Unable to replicate table '"} + table + "'");
+			}
+		}
+
+	}
+
+	size_t SQLite::Replica::capture() {
+
+		Changeset changeset;
+		changeset.captured = time(0);
+
+		{
+			// No transaction open, the changeset has only committed changes.
+			lock_guard<std::recursive_mutex> tlock(database->transaction);
+			lock_guard<std::mutex> lock(database->guard);
+
+			if(!session || sqlite3session_isempty(session)) {
+				return 0;
+			}
+
+			{
+				lock_guard<mutex> lock(guard);
+				if(failed) {
+					// Nothing is applied, don't keep recording the changes.
+					sqlite3session_delete(session);
+					session = nullptr;
+					return 0;
+				}
+			}
+
+			int length = 0;
+			void *data = nullptr;
+
+			int rc = sqlite3session_changeset(session,&length,&data);
+			if(rc != SQLITE_OK) {
+				throw runtime_error(sqlite3_errstr(rc));
+			}
+
+			changeset.data.assign((const char *) data,(size_t) length);
+			sqlite3_free(data);
+
+			// There's no reset, the next batch starts on a new session.
+			sqlite3session_delete(session);
+			session = nullptr;
+			start();
+		}
+
+		size_t length = changeset.data.size();
+
+		{
+			lock_guard<mutex> lock(guard);
+			changesets.push_back(std::move(changeset));
+		}
+		wakeup.notify_one();
+
+		return length;
+
+	}
+
+	time_t SQLite::Replica::lag() const {
+		lock_guard<mutex> lock(guard);
+		if(failed) {
+			return time(0) - failed;
+		}
+		if(changesets.empty()) {
+			return 0;
+		}
+		return time(0) - changesets.front().captured;
+	}
+
+	bool SQLite::Replica::diverged() const {
+		lock_guard<mutex> lock(guard);
+		return failed != 0;
+	}
+
+	size_t SQLite::Replica::pending() const {
+		lock_guard<mutex> lock(guard);
+		return changesets.size();
+	}
+
+#else
+
+	SQLite::Replica::Replica(std::shared_ptr<Database> db, const char *f, const std::vector<std::string> &t) : database{db}, filename{f}, tables{t} {
+		throw system_error(ENOTSUP,system_category(),"The sqlite3 library has no session extension");
+	}
+
+	SQLite::Replica::~Replica() {
+	}
+
+	void SQLite::Replica::start() {
+	}
+
+	size_t SQLite::Replica::capture() {
+		return 0;
+	}
+
+	time_t SQLite::Replica::lag() const {
+		return 0;
+	}
+
+	size_t SQLite::Replica::pending() const {
+		return 0;
+	}
+
+	bool SQLite::Replica::diverged() const {
+		return false;
+	}
+
+#endif // HAVE_SQLITE_SESSION
+
+ }
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/request.h>
+ #include <udjat/sqlite/database.h>
+ #include <udjat/tools/intl.h>
+ #include <string>
+ #include <vector>
+ #include <chrono>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Authorizer for reports, only reads are allowed.
+	static int readonly_authorizer(void *, int action, const char *, const char *, const char *, const char *) {
+		switch(action) {
+		case SQLITE_SELECT:
+		case SQLITE_READ:
+		case SQLITE_FUNCTION:
+		case SQLITE_RECURSIVE:
+			return SQLITE_OK;
+		}
+		return SQLITE_DENY;
+	}
+
+	/// @brief Progress handler, interrupts the query after the deadline.
+	static int deadline_handler(void *deadline) {
+		return std::chrono::steady_clock::now() > *((std::chrono::steady_clock::time_point *) deadline) ? 1 : 0;
+	}
+
+	size_t SQLite::Database::report(const char *sql, Udjat::Report &report, size_t max_rows, time_t max_time, const std::vector<std::string> &args, bool header) {
+
+		if(!db) {
+			throw runtime_error("Database is not available");
+		}
+
+		sqlite3_stmt *stmt = nullptr;
+
+		{
+			lock_guard<std::mutex> lock(guard);
+
+			// Virtual tables (like fts5) prepare their own statements when connected,
+			// prepare once without the authorizer to connect them.
+			if(sqlite3_prepare_v2(db,sql,-1,&stmt,NULL) == SQLITE_OK) {
+				sqlite3_finalize(stmt);
+				stmt = nullptr;
+			}
+
+			sqlite3_set_authorizer(db,readonly_authorizer,NULL);
+			int rc = sqlite3_prepare_v2(db,sql,-1,&stmt,NULL);
+			sqlite3_set_authorizer(db,authorizer,this);
+			check(rc);
+		}
+
+		size_t rows = 0;
+
+		try {
+
+			if(!sqlite3_stmt_readonly(stmt)) {
+				throw system_error(EPERM,system_category(),_( "Only read only queries are allowed on reports" ));
+			}
+
+			{
+				lock_guard<std::mutex> lock(guard);
+				for(size_t arg = 0; arg < args.size(); arg++) {
+					check(sqlite3_bind_text(stmt,arg+1,args[arg].c_str(),args[arg].size(),SQLITE_TRANSIENT));
+				}
+			}
+
+			int columns = sqlite3_column_count(stmt);
+
+			// Report::start() is null terminated, unused slots end the column list.
+			static const int max_columns = 16;
+			if(columns < 1 || columns > max_columns) {
+				throw runtime_error(string{"Reports must have between 1 and "} + std::to_string(max_columns) + " columns");
+			}
+
+			std::vector<std::string> names;
+			const char *name[max_columns+1];
+			for(int column = 0; column < columns; column++) {
+				names.emplace_back(sqlite3_column_name(stmt,column));
+			}
+			for(int column = 0; column <= max_columns; column++) {
+				name[column] = (column < columns ? names[column].c_str() : nullptr);
+			}
+
+			if(header) {
+				report.start(
+					name[0],name[1],name[2],name[3],name[4],name[5],name[6],name[7],
+					name[8],name[9],name[10],name[11],name[12],name[13],name[14],name[15],
+					name[16],
+					nullptr
+				);
+			}
+
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(max_time);
+			std::vector<std::string> values((size_t) columns);
+
+			while(!max_rows || rows < max_rows) {
+
+				int rc;
+				{
+					// Copy the row under the lock, the report is written without it.
+					lock_guard<std::mutex> lock(guard);
+
+					if(max_time) {
+						sqlite3_progress_handler(db,1000,deadline_handler,&deadline);
+					}
+					rc = sqlite3_step(stmt);
+					if(max_time) {
+						sqlite3_progress_handler(db,0,NULL,NULL);
+					}
+
+					if(rc == SQLITE_ROW) {
+						for(int column = 0; column < columns; column++) {
+							const char *str = (const char *) sqlite3_column_text(stmt,column);
+							values[column].assign(str ? str : "");
+						}
+					}
+				}
+
+				if(rc == SQLITE_INTERRUPT) {
+					throw system_error(ETIMEDOUT,system_category(),_( "Report time limit exceeded" ));
+				}
+
+				if(rc != SQLITE_ROW) {
+					check(rc);
+					break;
+				}
+
+				for(const std::string &value : values) {
+					report << value;
+				}
+				rows++;
+
+			}
+
+		} catch(...) {
+
+			lock_guard<std::mutex> lock(guard);
+			sqlite3_finalize(stmt);
+			throw;
+
+		}
+
+		lock_guard<std::mutex> lock(guard);
+		sqlite3_finalize(stmt);
+
+		return rows;
+
+	}
+
+ }
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <pugixml.hpp>
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/request.h>
+ #include <udjat/sqlite/database.h>
+ #include <udjat/sqlite/statement.h>
+ #include <udjat/sqlite/protocol.h>
+ #include <udjat/tools/logger.h>
+ #include <algorithm>
+ #include <system_error>
+ #include <cstring>
+ #include <cstdlib>
+ #include <string>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	static const char * result_names[] = { "2xx", "3xx", "4xx", "5xx", "error", "invalid" };
+	static const char * action_names[] = { "delete", "retry", "dead-letter" };
+
+	SQLite::Protocol::Policy SQLite::Protocol::policies(const pugi::xml_node &node) const {
+
+		Policy policy;
+
+		for(auto child = node.child("on"); child; child = child.next_sibling("on")) {
+
+			const char *status = child.attribute("status").as_string();
+			const char *name = child.attribute("action").as_string();
+
+			Action action = Delete;
+			{
+				size_t ix = 0;
+				while(ix < (sizeof(action_names)/sizeof(action_names[0])) && strcmp(name,action_names[ix])) {
+					ix++;
+				}
+				if(ix >= (sizeof(action_names)/sizeof(action_names[0]))) {
+					throw runtime_error(string{"Invalid action '"} + name + "' on status '" + status + "'");
+				}
+				action = (Action) ix;
+			}
+
+			size_t result = 0;
+			while(result < Results && strcmp(status,result_names[result])) {
+				result++;
+			}
+
+			if(result < Results) {
+				policy.results[result] = action;
+				continue;
+			}
+
+			char *end = nullptr;
+			long code = strtol(status,&end,10);
+			if(!*status || *end || code < 100 || code > 599) {
+				throw runtime_error(string{"Invalid status '"} + status + "'");
+			}
+			policy.status[(int) code] = action;
+
+		}
+
+		return policy;
+
+	}
+
+	SQLite::Protocol::Result SQLite::Protocol::classify(const std::error_code &code, int &status) {
+
+		status = 0;
+
+		// The HTTP client reports the status as the error code, on its own category.
+		if(code.category() == std::system_category() || code.category() == std::generic_category()) {
+			return Failure;
+		}
+
+		int value = code.value();
+		if(value < 100 || value > 599) {
+			return Failure;
+		}
+
+		status = value;
+		return (value < 300 ? Success : (value < 400 ? Redirect : (value < 500 ? ClientError : ServerError)));
+
+	}
+
+	SQLite::Protocol::Action SQLite::Protocol::dispatch(const Message &message, int &status) {
+
+		Result result = Failure;
+		status = 0;
+
+		try {
+
+			if(deliver(message)) {
+				result = Success;
+				status = 200;
+			} else {
+				result = Invalid;
+			}
+
+		} catch(const std::system_error &e) {
+
+			result = classify(e.code(),status);
+			warning() << "Error sending request '" << message.id << "' (" << result_names[result] << "): " << e.what() << endl;
+
+		} catch(const std::exception &e) {
+
+			warning() << "Error sending request '" << message.id << "': " << e.what() << endl;
+
+		} catch(...) {
+
+			warning() << "Unexpected error sending request '" << message.id << "'" << endl;
+
+		}
+
+		counters[result]++;
+
+		lock_guard<mutex> lock(guard);
+
+		Action action = policy.results[result];
+		if(status) {
+			auto it = policy.status.find(status);
+			if(it != policy.status.end()) {
+				action = it->second;
+			}
+		}
+
+		if(action == Retry) {
+			backoff.delay = (backoff.delay ? std::min(backoff.delay * 2, backoff.max) : std::max(send_delay,(time_t) 1));
+			backoff.until = time(0) + backoff.delay;
+		} else {
+			backoff.delay = backoff.until = 0;
+		}
+
+		return action;
+
+	}
+
+	void SQLite::Protocol::bury(const Shard &shard, const Message &message, int status) {
+
+		if(!shard.dead) {
+			error() << "Dropping request '" << message.id << "' (" << message.action << " " << message.url << "), no dead letter table" << endl;
+			return;
+		}
+
+		warning() << "Moving request '" << message.id << "' to the dead letters" << endl;
+
+		string code{std::to_string(status)};
+
+		shard.dead->reset();
+		shard.dead->bind(
+			message.url.c_str(),
+			message.action.c_str(),
+			message.payload.c_str(),
+			code.c_str(),
+			nullptr
+		);
+		shard.dead->exec();
+		shard.dead->reset();
+
+	}
+
+	void SQLite::Protocol::statistics(Report &report) const {
+
+		report.start("result","action","requests",nullptr);
+
+		lock_guard<mutex> lock(guard);
+		for(size_t result = 0; result < Results; result++) {
+			report << string{result_names[result]};
+			report << string{action_names[policy.results[result]]};
+			report << std::to_string(counters[result].load());
+		}
+
+	}
+
+ }
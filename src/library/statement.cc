@@ -22,7 +22,9 @@
  #include <udjat/sqlite/statement.h>
  #include <iostream>
  #include <cstring>
+ #include <strings.h>
  #include <cstdarg>
+ #include <algorithm>
 
  using namespace std;
 
@@ -35,16 +37,51 @@
 		}
 
 		lock_guard<std::mutex> lock(database->guard);
-		database->check(sqlite3_prepare_v2(
+
+		// Collect the tables read by the statement, used to invalidate cached results.
+		sqlite3_set_authorizer(database->db,authorizer,this);
+		int rc = sqlite3_prepare_v2(
 			database->db,		// Database handle
 			sql,				// SQL statement, UTF-8 encoded
 			-1,					// Maximum length of zSql in bytes.
 			&stmt,				// OUT: Statement handle
 			NULL				// OUT: Pointer to unused portion of zSql
-		));
+		);
+		sqlite3_set_authorizer(database->db,Database::authorizer,database.get());
+		database->check(rc);
 
  	}
 
+	int SQLite::Statement::authorizer(void *ptr, int action, const char *arg1, const char *arg2, const char *, const char *) {
+
+		Statement &statement = *((Statement *) ptr);
+
+		if(action == SQLITE_READ && arg1) {
+
+			if(std::find(statement.tables.begin(),statement.tables.end(),arg1) == statement.tables.end()) {
+				statement.tables.push_back(arg1);
+			}
+
+		} else if(action == SQLITE_FUNCTION && arg2) {
+
+			// Results depending on the clock or on the connection state can't be cached.
+			static const char *functions[] = {
+				"random", "randomblob", "changes", "total_changes", "last_insert_rowid",
+				"date", "time", "datetime", "julianday", "unixepoch", "strftime", "timediff",
+				"current_date", "current_time", "current_timestamp"
+			};
+
+			for(const char *function : functions) {
+				if(!strcasecmp(arg2,function)) {
+					statement.cacheable = false;
+				}
+			}
+
+		}
+
+		return Database::authorizer(statement.database.get(),action,arg1,arg2,nullptr,nullptr);
+	}
+
  	SQLite::Statement::~Statement() {
 		lock_guard<std::mutex> lock(database->guard);
 		sqlite3_finalize(stmt);
@@ -56,12 +93,79 @@
 	}
 
 	int SQLite::Statement::step() {
-		lock_guard<std::mutex> lock(database->guard);
-		return sqlite3_step(stmt);
+		int rc;
+		{
+			lock_guard<std::recursive_mutex> tlock(database->transaction);
+			lock_guard<std::mutex> lock(database->guard);
+			rc = sqlite3_step(stmt);
+		}
+		database->notify();
+		return rc;
 	}
 
-	void SQLite::Statement::exec() {
-		database->check(step());
+	std::shared_ptr<const SQLite::Result> SQLite::Statement::fetch() {
+
+		std::string key;
+		uint64_t epoch = 0;
+
+		if(database->results.limit && cacheable && sqlite3_stmt_readonly(stmt) && database->cacheable(tables)) {
+
+			{
+				lock_guard<std::mutex> lock(database->guard);
+				char *sql = sqlite3_expanded_sql(stmt);
+				if(sql) {
+					key = sql;
+					sqlite3_free(sql);
+				}
+			}
+
+			if(!key.empty()) {
+				auto result = database->cached(key);
+				if(result) {
+					return result;
+				}
+				epoch = database->epoch();
+			}
+
+		}
+
+		auto result = make_shared<Result>();
+
+		reset();
+		int rc;
+		while((rc = step()) == SQLITE_ROW) {
+			lock_guard<std::mutex> lock(database->guard);
+			int columns = sqlite3_column_count(stmt);
+			std::vector<std::string> row;
+			row.reserve(columns);
+			for(int column = 0; column < columns; column++) {
+				const char *str = (const char *) sqlite3_column_text(stmt,column);
+				row.emplace_back(str ? str : "");
+				result->size += row.back().capacity() + sizeof(std::string);
+			}
+			result->size += sizeof(row);
+			result->rows.push_back(std::move(row));
+		}
+		reset();
+		database->check(rc);
+
+		if(!key.empty()) {
+			database->cache(key,result,tables,epoch);
+		}
+
+		return result;
+	}
+
+	size_t SQLite::Statement::exec() {
+		size_t changes;
+		{
+			lock_guard<std::recursive_mutex> tlock(database->transaction);
+			lock_guard<std::mutex> lock(database->guard);
+			database->check(sqlite3_step(stmt));
+			changes = (size_t) sqlite3_changes(database->db);
+		}
+		database->notify();
+		return changes;
 	}
 
 	void SQLite::Statement::get(int column, int64_t &value) {
@@ -69,6 +173,11 @@
 		value = sqlite3_column_int64(stmt,column);
 	}
 
+	void SQLite::Statement::get(int column, double &value) {
+		lock_guard<std::mutex> lock(database->guard);
+		value = sqlite3_column_double(stmt,column);
+	}
+
 	void SQLite::Statement::get(int column, string &value) {
 		lock_guard<std::mutex> lock(database->guard);
 		const char *str = (const char *) sqlite3_column_text(stmt,column);
@@ -78,6 +187,15 @@
 			value.clear();
 	}
 
+	void SQLite::Statement::bytes(int column, string &value) {
+		lock_guard<std::mutex> lock(database->guard);
+		const char *data = (const char *) sqlite3_column_blob(stmt,column);
+		if(data)
+			value.assign(data,sqlite3_column_bytes(stmt,column));
+		else
+			value.clear();
+	}
+
 	SQLite::Statement & SQLite::Statement::bind(int column, const char *value) {
 		lock_guard<std::mutex> lock(database->guard);
 		database->check(
@@ -91,6 +209,19 @@
 		return *this;
 	}
 
+	SQLite::Statement & SQLite::Statement::bind(int column, const std::string &value) {
+		lock_guard<std::mutex> lock(database->guard);
+		database->check(
+			sqlite3_bind_text(
+				stmt,
+				column,
+				value.c_str(),
+				value.size(),
+				SQLITE_TRANSIENT
+			)	);
+		return *this;
+	}
+
 	SQLite::Statement & SQLite::Statement::bind(int column, const int64_t value) {
 		lock_guard<std::mutex> lock(database->guard);
 		database->check(
@@ -102,6 +233,17 @@
 		return *this;
 	}
 
+	SQLite::Statement & SQLite::Statement::bind(int column, const double value) {
+		lock_guard<std::mutex> lock(database->guard);
+		database->check(
+			sqlite3_bind_double(
+				stmt,
+				column,
+				value
+			)	);
+		return *this;
+	}
+
 	SQLite::Statement & SQLite::Statement::bind(const char *arg,...) {
 
 		size_t column = 0;
@@ -0,0 +1,398 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <udjat/sqlite/timeseries.h>
+ #include <udjat/sqlite/statement.h>
+ #include <iostream>
+ #include <map>
+ #include <tuple>
+ #include <algorithm>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Rollup tables, indexed by resolution.
+	static const struct {
+		const char *table;
+		time_t seconds;
+	} rollups[] = {
+		{ "ts_samples",	1 		},
+		{ "ts_minutes",	60		},
+		{ "ts_hours",	3600	},
+		{ "ts_days",	86400	},
+	};
+
+	SQLite::TimeSeries::TimeSeries(std::shared_ptr<Database> db, size_t b) : database{db}, batch{b}, limit{b * 64} {
+
+		database->exec(
+			"create table if not exists ts_series ("
+				"id integer primary key, "
+				"name text unique not null, "
+				"base integer not null"
+			")"
+		);
+
+		database->exec(
+			"create table if not exists ts_samples ("
+				"series integer not null, "
+				"delta integer not null, "
+				"value real, "
+				"primary key (series,delta)"
+			") without rowid"
+		);
+
+		for(size_t ix = SQLite::TimeSeries::Minute; ix < (sizeof(rollups)/sizeof(rollups[0])); ix++) {
+			database->exec(
+				(string{"create table if not exists "} + rollups[ix].table + " ("
+					"series integer not null, "
+					"bucket integer not null, "
+					"minimum real, "
+					"maximum real, "
+					"total real, "
+					"samples integer, "
+					"primary key (series,bucket)"
+				") without rowid").c_str()
+			);
+		}
+
+		buffer.reserve(batch);
+
+	}
+
+	SQLite::TimeSeries::~TimeSeries() {
+		try {
+			flush();
+		} catch(const std::exception &e) {
+			cerr << "sqlite\tError flushing time series: " << e.what() << endl;
+		}
+	}
+
+	bool SQLite::TimeSeries::find(const char *name, Series &entry) {
+
+		auto it = series.find(name);
+		if(it != series.end()) {
+			entry = it->second;
+			return true;
+		}
+
+		Statement select(database,"select id,base from ts_series where name=?");
+		select.bind(1,name);
+		if(select.step() != SQLITE_ROW) {
+			select.reset();
+			return false;
+		}
+
+		int64_t base;
+		select.get(0,entry.id);
+		select.get(1,base);
+		select.reset();
+		entry.base = (time_t) base;
+
+		series[name] = entry;
+		bases[entry.id] = entry.base;
+
+		return true;
+	}
+
+	int64_t SQLite::TimeSeries::id(const char *name) {
+
+		lock_guard<mutex> lock(guard);
+
+		Series entry;
+		if(find(name,entry)) {
+			return entry.id;
+		}
+
+		Statement(database,"insert into ts_series (name,base) values (?,?)").bind(1,name).bind(2,(int64_t) time(0)).exec();
+
+		if(!find(name,entry)) {
+			throw runtime_error(string{"Unable to create series '"} + name + "'");
+		}
+
+		return entry.id;
+	}
+
+	bool SQLite::TimeSeries::push_back(int64_t id, double value, time_t timestamp) {
+
+		if(!timestamp) {
+			timestamp = time(0);
+		}
+
+		lock_guard<mutex> lock(guard);
+
+		auto base = bases.find(id);
+		if(base == bases.end()) {
+			throw runtime_error("Unknown series id");
+		}
+
+		buffer.push_back({id,(int64_t) (timestamp - base->second),timestamp,value});
+		shrink();
+
+		return buffer.size() >= batch;
+	}
+
+	size_t SQLite::TimeSeries::size() {
+		lock_guard<mutex> lock(guard);
+		return buffer.size();
+	}
+
+	void SQLite::TimeSeries::capacity(size_t samples) {
+		lock_guard<mutex> lock(guard);
+		limit = std::max(samples,batch);
+		shrink();
+	}
+
+	size_t SQLite::TimeSeries::dropped() {
+		lock_guard<mutex> lock(guard);
+		return overflow;
+	}
+
+	void SQLite::TimeSeries::shrink() {
+		if(buffer.size() > limit) {
+			size_t count = buffer.size() - limit;
+			buffer.erase(buffer.begin(),buffer.begin() + count);
+			overflow += count;
+		}
+	}
+
+	size_t SQLite::TimeSeries::flush() {
+
+		std::vector<Sample> samples;
+		{
+			lock_guard<mutex> lock(guard);
+			samples.swap(buffer);
+			buffer.reserve(batch);
+		}
+
+		if(samples.empty()) {
+			return 0;
+		}
+
+		try {
+
+			Database::Transaction transaction{database};
+
+			// Aggregate the inserted samples in memory, one upsert per bucket.
+			struct Aggregate {
+				double minimum;
+				double maximum;
+				double total = 0;
+				int64_t samples = 0;
+			};
+
+			std::map<std::tuple<size_t,int64_t,int64_t>,Aggregate> aggregates;
+
+			{
+				// A second sample on the same second is ignored, the rollups already have the first one.
+				Statement insert(database,"insert or ignore into ts_samples (series,delta,value) values (?,?,?)");
+
+				for(const Sample &sample : samples) {
+
+					insert.reset();
+					if(!insert.bind(1,sample.series).bind(2,sample.delta).bind(3,sample.value).exec()) {
+						continue;
+					}
+
+					for(size_t ix = Minute; ix < (sizeof(rollups)/sizeof(rollups[0])); ix++) {
+						auto result = aggregates.emplace(
+							std::make_tuple(ix,sample.series,(int64_t) (sample.timestamp / rollups[ix].seconds)),
+							Aggregate{sample.value,sample.value}
+						);
+						Aggregate &aggregate = result.first->second;
+						aggregate.minimum = std::min(aggregate.minimum,sample.value);
+						aggregate.maximum = std::max(aggregate.maximum,sample.value);
+						aggregate.total += sample.value;
+						aggregate.samples++;
+					}
+
+				}
+			}
+
+			std::shared_ptr<Statement> upsert[sizeof(rollups)/sizeof(rollups[0])];
+			for(size_t ix = Minute; ix < (sizeof(rollups)/sizeof(rollups[0])); ix++) {
+				upsert[ix] = make_shared<Statement>(
+					database,
+					(string{"insert into "} + rollups[ix].table + " (series,bucket,minimum,maximum,total,samples) values (?,?,?,?,?,?) "
+						"on conflict (series,bucket) do update set "
+							"minimum=min(minimum,excluded.minimum), "
+							"maximum=max(maximum,excluded.maximum), "
+							"total=total+excluded.total, "
+							"samples=samples+excluded.samples").c_str()
+				);
+			}
+
+			for(auto &it : aggregates) {
+				Statement &stmt = *upsert[std::get<0>(it.first)];
+				stmt.reset();
+				stmt.bind(1,std::get<1>(it.first))
+					.bind(2,std::get<2>(it.first))
+					.bind(3,it.second.minimum)
+					.bind(4,it.second.maximum)
+					.bind(5,it.second.total)
+					.bind(6,it.second.samples)
+					.exec();
+			}
+
+			transaction.commit();
+
+		} catch(...) {
+
+			// Keep the samples for the next flush, up to the buffer limit.
+			lock_guard<mutex> lock(guard);
+			buffer.insert(buffer.begin(),samples.begin(),samples.end());
+			shrink();
+			throw;
+
+		}
+
+		return samples.size();
+	}
+
+ 	time_t SQLite::TimeSeries::retention(Resolution resolution) const {
+		return retention_time[resolution];
+	}
+
+	void SQLite::TimeSeries::retention(Resolution resolution, time_t seconds) {
+		retention_time[resolution] = seconds;
+	}
+
+	size_t SQLite::TimeSeries::trim(size_t limit) {
+
+		// Called from background tasks, don't stack them.
+		std::unique_lock<std::mutex> running(trimming,std::try_to_lock);
+		if(!running.owns_lock()) {
+			return 0;
+		}
+
+		std::vector<std::pair<int64_t,time_t>> series;
+		{
+			lock_guard<mutex> lock(guard);
+			for(auto &it : bases) {
+				series.push_back(it);
+			}
+		}
+
+		size_t removed = 0;
+		time_t now = time(0);
+
+		for(size_t ix = Raw; ix < (sizeof(rollups)/sizeof(rollups[0])); ix++) {
+
+			if(!retention_time[ix]) {
+				continue;
+			}
+
+			time_t limit_time = now - retention_time[ix];
+
+			// Raw samples are keyed by delta, rollups by bucket.
+			const char *column = (ix == Raw ? "delta" : "bucket");
+			Statement del(
+				database,
+				(string{"delete from "} + rollups[ix].table + " where series=?1 and " + column + " in "
+					"(select " + column + " from " + rollups[ix].table + " where series=?1 and " + column + " < ?2 limit ?3)").c_str()
+			);
+
+			for(auto &it : series) {
+				int64_t key = (ix == Raw ? (int64_t) (limit_time - it.second) : (int64_t) (limit_time / rollups[ix].seconds));
+				del.reset();
+				removed += del.bind(1,it.first).bind(2,key).bind(3,(int64_t) limit).exec();
+			}
+
+		}
+
+		return removed;
+	}
+
+	SQLite::TimeSeries::Resolution SQLite::TimeSeries::resolution(time_t from, time_t to, size_t points) const {
+
+		time_t step = (to - from) / (points ? points : 1);
+		time_t oldest = time(0) - from;
+
+		size_t selected = Raw;
+		for(size_t ix = Minute; ix < (sizeof(rollups)/sizeof(rollups[0])); ix++) {
+			if(rollups[ix].seconds <= step) {
+				selected = ix;
+			}
+		}
+
+		// Finer resolutions may have expired for the beginning of the range.
+		while(selected < Day && retention_time[selected] && retention_time[selected] < oldest) {
+			selected++;
+		}
+
+		return (Resolution) selected;
+
+	}
+
+	SQLite::TimeSeries::Resolution SQLite::TimeSeries::get(const char *name, time_t from, time_t to, size_t points, const std::function<void(time_t timestamp, double min, double max, double avg, size_t count)> &call) {
+
+		int64_t series;
+		time_t base;
+		{
+			lock_guard<mutex> lock(guard);
+			Series entry;
+			if(!find(name,entry)) {
+				// Unknown series, nothing recorded yet.
+				return resolution(from,to,points);
+			}
+			series = entry.id;
+			base = entry.base;
+		}
+
+		Resolution res = resolution(from,to,points);
+
+		if(res == Raw) {
+
+			Statement select(database,"select delta,value from ts_samples where series=? and delta between ? and ? order by delta");
+			select.bind(1,series).bind(2,(int64_t) (from - base)).bind(3,(int64_t) (to - base));
+
+			while(select.step() == SQLITE_ROW) {
+				int64_t delta;
+				double value;
+				select.get(0,delta);
+				select.get(1,value);
+				call(base+delta,value,value,value,1);
+			}
+
+		} else {
+
+			Statement select(
+				database,
+				(string{"select bucket,minimum,maximum,total,samples from "} + rollups[res].table + " where series=? and bucket between ? and ? order by bucket").c_str()
+			);
+			select.bind(1,series).bind(2,(int64_t) (from / rollups[res].seconds)).bind(3,(int64_t) (to / rollups[res].seconds));
+
+			while(select.step() == SQLITE_ROW) {
+				int64_t bucket, samples;
+				double minimum, maximum, total;
+				select.get(0,bucket);
+				select.get(1,minimum);
+				select.get(2,maximum);
+				select.get(3,total);
+				select.get(4,samples);
+				call(bucket * rollups[res].seconds,minimum,maximum,(samples ? total/samples : 0),(size_t) samples);
+			}
+
+		}
+
+		return res;
+	}
+
+ }
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include <pugixml.hpp>
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/sqlite/database.h>
+ #include <udjat/sqlite/statement.h>
+ #include <udjat/sqlite/protocol.h>
+ #include <udjat/tools/logger.h>
+ #include <string>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	void SQLite::Protocol::watermarks(std::shared_ptr<Database> db, const char *table) {
+
+		db->exec(
+			"create table if not exists udjat_watermarks ("
+				"tbl text not null primary key, "
+				"delivered integer not null"
+			") without rowid"
+		);
+
+		// Undelivered rows at or below the watermark, kept small by sending them first.
+		db->exec((string{"create table if not exists "} + table + "_exceptions (id integer primary key)").c_str());
+
+		// Everything queued before enabling the watermark is still pending.
+		Statement(db,"insert or ignore into udjat_watermarks (tbl,delivered) values (?,0)").bind(1,string{table}).exec();
+
+	}
+
+	void SQLite::Protocol::purge(std::shared_ptr<Database> db, const char *table) {
+
+		int64_t delivered = 0;
+		{
+			Statement select(db,"select delivered from udjat_watermarks where tbl=?");
+			select.bind(1,string{table});
+			if(select.step() == SQLITE_ROW) {
+				select.get(0,delivered);
+			}
+			select.reset();
+		}
+
+		// The row on the watermark is kept: without AUTOINCREMENT sqlite reuses the rowids
+		// above the highest row, deleting it would let new requests get ids below the watermark.
+		size_t rows = Statement(
+							db,
+							(string{"delete from "} + table + " where rowid < ?1 and rowid not in (select id from " + table + "_exceptions)").c_str()
+						).bind(1,delivered).exec();
+
+		if(rows) {
+			info() << "Purged " << rows << " delivered request(s) from '" << table << "'" << endl;
+		}
+
+	}
+
+ }
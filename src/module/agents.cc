@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include "private.h"
+ #include <udjat/agent.h>
+ #include <udjat/tools/logger.h>
+ #include <sqlite3.h>
+ #include <string>
+ #include <vector>
+ #include <cstring>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief 'udjat_agents' virtual table, the live agent tree.
+	namespace AgentTable {
+
+		enum Column : int {
+			Name,
+			Path,
+			Value,
+			State,
+			Level,
+			Summary
+		};
+
+		struct Cursor : public sqlite3_vtab_cursor {
+
+			struct Row {
+				std::shared_ptr<Abstract::Agent> agent;
+				std::string path;
+			};
+
+			/// @brief Agents, values are read only when the column is requested.
+			std::vector<Row> rows;
+			size_t current = 0;
+
+			void load(std::shared_ptr<Abstract::Agent> agent, const std::string &path) {
+				for(auto child : *agent) {
+					std::string name{path + "/" + child->name()};
+					rows.push_back({child,name});
+					load(child,name);
+				}
+			}
+
+		};
+
+		static int connect(sqlite3 *db, void *, int, const char * const *, sqlite3_vtab **vtab, char **) {
+
+			int rc = sqlite3_declare_vtab(db,"create table x(name text, path text, value text, state text, level integer, summary text)");
+			if(rc != SQLITE_OK) {
+				return rc;
+			}
+
+			*vtab = (sqlite3_vtab *) sqlite3_malloc(sizeof(sqlite3_vtab));
+			if(!*vtab) {
+				return SQLITE_NOMEM;
+			}
+			memset(*vtab,0,sizeof(sqlite3_vtab));
+
+			return SQLITE_OK;
+		}
+
+		static int disconnect(sqlite3_vtab *vtab) {
+			sqlite3_free(vtab);
+			return SQLITE_OK;
+		}
+
+		static int best_index(sqlite3_vtab *, sqlite3_index_info *info) {
+			// Always a full scan of the tree.
+			info->estimatedCost = 10000;
+			info->estimatedRows = 1000;
+			return SQLITE_OK;
+		}
+
+		static int open(sqlite3_vtab *, sqlite3_vtab_cursor **cursor) {
+			try {
+				*cursor = new Cursor();
+			} catch(...) {
+				return SQLITE_NOMEM;
+			}
+			return SQLITE_OK;
+		}
+
+		static int close(sqlite3_vtab_cursor *cursor) {
+			delete ((Cursor *) cursor);
+			return SQLITE_OK;
+		}
+
+		static int filter(sqlite3_vtab_cursor *ptr, int, const char *, int, sqlite3_value **) {
+
+			Cursor *cursor = (Cursor *) ptr;
+			cursor->rows.clear();
+			cursor->current = 0;
+
+			try {
+
+				auto root = Abstract::Agent::root();
+				if(root) {
+					cursor->load(root,"");
+				}
+
+			} catch(const std::exception &e) {
+
+				ptr->pVtab->zErrMsg = sqlite3_mprintf("%s",e.what());
+				return SQLITE_ERROR;
+
+			}
+
+			return SQLITE_OK;
+		}
+
+		static int next(sqlite3_vtab_cursor *cursor) {
+			((Cursor *) cursor)->current++;
+			return SQLITE_OK;
+		}
+
+		static int eof(sqlite3_vtab_cursor *ptr) {
+			Cursor *cursor = (Cursor *) ptr;
+			return cursor->current >= cursor->rows.size();
+		}
+
+		static int column(sqlite3_vtab_cursor *ptr, sqlite3_context *context, int column) {
+
+			Cursor::Row &row = ((Cursor *) ptr)->rows[((Cursor *) ptr)->current];
+
+			try {
+
+				switch((Column) column) {
+				case Name:
+					sqlite3_result_text(context,row.agent->name(),-1,SQLITE_TRANSIENT);
+					break;
+
+				case Path:
+					sqlite3_result_text(context,row.path.c_str(),-1,SQLITE_TRANSIENT);
+					break;
+
+				case Value:
+					sqlite3_result_text(context,row.agent->to_string().c_str(),-1,SQLITE_TRANSIENT);
+					break;
+
+				case State:
+					sqlite3_result_text(context,row.agent->state()->name(),-1,SQLITE_TRANSIENT);
+					break;
+
+				case Level:
+					sqlite3_result_int(context,(int) row.agent->state()->level());
+					break;
+
+				case Summary:
+					sqlite3_result_text(context,row.agent->state()->summary(),-1,SQLITE_TRANSIENT);
+					break;
+
+				default:
+					sqlite3_result_null(context);
+				}
+
+			} catch(const std::exception &e) {
+
+				sqlite3_result_error(context,e.what(),-1);
+
+			}
+
+			return SQLITE_OK;
+		}
+
+		static int rowid(sqlite3_vtab_cursor *cursor, sqlite_int64 *rowid) {
+			*rowid = (sqlite_int64) ((Cursor *) cursor)->current;
+			return SQLITE_OK;
+		}
+
+		static sqlite3_module module = {
+			0,				// iVersion
+			NULL,			// xCreate, NULL makes it eponymous only.
+			connect,		// xConnect
+			best_index,		// xBestIndex
+			disconnect,		// xDisconnect
+			disconnect,		// xDestroy
+			open,			// xOpen
+			close,			// xClose
+			filter,			// xFilter
+			next,			// xNext
+			eof,			// xEof
+			column,			// xColumn
+			rowid,			// xRowid
+			NULL,			// xUpdate
+			NULL,			// xBegin
+			NULL,			// xSync
+			NULL,			// xCommit
+			NULL,			// xRollback
+			NULL,			// xFindMethod
+			NULL,			// xRename
+			NULL,			// xSavepoint
+			NULL,			// xRelease
+			NULL,			// xRollbackTo
+			NULL			// xShadowName
+		};
+
+	}
+
+	void SQLite::Module::install_agent_table(sqlite3 *db) {
+		if(sqlite3_create_module(db,"udjat_agents",&AgentTable::module,NULL) != SQLITE_OK) {
+			throw runtime_error(sqlite3_errmsg(db));
+		}
+	}
+
+ }
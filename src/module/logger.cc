@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include "private.h"
+ #include <pugixml.hpp>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/sqlite/logwriter.h>
+ #include <iostream>
+ #include <cstring>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Stream buffer copying complete lines to the log writer.
+	class UDJAT_PRIVATE LogCapture : public std::streambuf {
+	private:
+		std::ostream &stream;
+		std::streambuf *original;
+		Logger::Level level;
+		SQLite::LogWriter &writer;
+
+		std::mutex guard;
+		std::string line;
+
+		/// @brief Send line as "domain<tab>message".
+		void forward() {
+
+			if(line.empty() || writer.writer()) {
+				return;
+			}
+
+			const char *text = line.c_str();
+			const char *tab = strchr(text,'\t');
+
+			if(tab && !memchr(text,' ',tab-text)) {
+				writer.write(level,string{text,(size_t) (tab-text)}.c_str(),tab+1);
+			} else {
+				writer.write(level,"",text);
+			}
+
+		}
+
+	protected:
+		int overflow(int c) override {
+
+			if(c == EOF) {
+				return original->pubsync() == 0 ? 0 : EOF;
+			}
+
+			{
+				lock_guard<mutex> lock(guard);
+				if(c == '\n') {
+					forward();
+					line.clear();
+				} else {
+					line += (char) c;
+				}
+			}
+
+			return original->sputc(c);
+		}
+
+		std::streamsize xsputn(const char *s, std::streamsize n) override {
+
+			{
+				lock_guard<mutex> lock(guard);
+				for(std::streamsize ix = 0; ix < n; ix++) {
+					if(s[ix] == '\n') {
+						forward();
+						line.clear();
+					} else {
+						line += s[ix];
+					}
+				}
+			}
+
+			return original->sputn(s,n);
+		}
+
+		int sync() override {
+			return original->pubsync();
+		}
+
+	public:
+		LogCapture(std::ostream &s, Logger::Level l, SQLite::LogWriter &w) : stream{s}, original{s.rdbuf()}, level{l}, writer{w} {
+			stream.rdbuf(this);
+		}
+
+		virtual ~LogCapture() {
+			stream.rdbuf(original);
+		}
+
+	};
+
+	SQLite::Module::LogSink::LogSink(std::shared_ptr<Database> database, const XML::Node &node)
+		: writer{
+			database,
+			Object::getAttribute(node, "sqlite", "batch-size", (unsigned int) 256),
+			Object::getAttribute(node, "sqlite", "retention", (unsigned int) 604800)
+		} {
+
+		captures.push_back(make_shared<LogCapture>(cout,Logger::Info,writer));
+		captures.push_back(make_shared<LogCapture>(clog,Logger::Warning,writer));
+		captures.push_back(make_shared<LogCapture>(cerr,Logger::Error,writer));
+
+	}
+
+	SQLite::Module::LogSink::~LogSink() {
+		// Restore the streams before stopping the writer.
+		captures.clear();
+	}
+
+ }
@@ -31,6 +31,11 @@
  #include <udjat/tools/logger.h>
  #include <udjat/module.h>
  #include <udjat/sqlite/sql.h>
+ #include <udjat/request.h>
+ #include <cstring>
+ #include <cstdio>
+ #include <fstream>
+ #include <system_error>
 
  using namespace std;
 
@@ -55,10 +60,14 @@
 	}
 
 	SQLite::Module::Module() : Udjat::Module("sqlite",moduleinfo), Udjat::Factory("sql",moduleinfo), database(DatabaseFactory()) {
+		database->cache(Config::Value<unsigned int>("sqlite","cache-size",0));
+		database->extend(install_agent_table);
 	}
 
 	/// @brief Create module from XML definition with fallback to configuration file.
 	SQLite::Module::Module(const pugi::xml_node &node) : Udjat::Module("sqlite",moduleinfo), Udjat::Factory("sql",moduleinfo), database(DatabaseFactory(node)) {
+		database->cache(Object::getAttribute(node, "sqlite", "cache-size", (unsigned int) Config::Value<unsigned int>("sqlite","cache-size",0)));
+		database->extend(install_agent_table);
 	}
 
 	SQLite::Module::~Module() {
@@ -84,6 +93,15 @@
 
 		}
 
+		if(String{node,"type"} == "log") {
+			//
+			// Store log records on database.
+			//
+			logsink.reset();
+			logsink = make_shared<LogSink>(database,node);
+			return true;
+		}
+
 		return false;
 
 	}
@@ -96,9 +114,25 @@
 			//
 			// Register SQL as protocol handler and queue status agent.
 			//
-			auto protocol = make_shared<Protocol>(database,node);
+			shared_ptr<Protocol> protocol;
 
 			{
+				// On reconfiguration reload the active handler in place, the queue keeps draining.
+				const char *name = Quark(node,"name","sql",false).c_str();
+				for(auto active : protocols) {
+					if(!strcmp(active->c_str(),name)) {
+						Udjat::Factory::info() << "Reloading protocol handler '" << name << "'" << endl;
+						active->reload(node);
+						protocol = active;
+						break;
+					}
+				}
+			}
+
+			if(!protocol) {
+
+				protocol = make_shared<Protocol>(database,node);
+
 				SQLite::Module * module = const_cast<SQLite::Module *>(this);
 				if(!module) {
 					throw runtime_error("Cant cast module as volatile");
@@ -125,6 +159,30 @@
 					time_t timer = 1800;
 				} retry;
 
+				/// @brief Directory for queue export and import, empty to disable them.
+				std::string backups;
+
+				/// @brief Get the path of a backup file, only plain names on the backup directory are accepted.
+				std::string backup(const std::string &name) const {
+
+					if(backups.empty()) {
+						throw system_error(EPERM,system_category(),"Queue export and import are disabled, set 'backup-path' on the queue agent");
+					}
+
+					if(name.empty() || name[0] == '.' || name.find_first_of("/\\") != string::npos) {
+						throw system_error(EINVAL,system_category(),"Invalid backup file name");
+					}
+
+					return backups + "/" + name;
+				}
+
+				/// @brief Export and import write files and the queue, they are refused on GET.
+				static void action(const Request &request) {
+					if(request.verb() != HTTP::Post) {
+						throw system_error(EPERM,system_category(),"Queue export and import are actions, use POST");
+					}
+				}
+
 			public:
 				Agent(shared_ptr<Protocol> p, const XML::Node &node) : Udjat::Agent<unsigned int>(node), protocol(p) {
 					protocol->insert(this);
@@ -158,9 +216,71 @@
 
 					timers.failed = Object::getAttribute(node, "sqlite", "wait-after-fail", (unsigned int) timers.empty);
 
+					backups = node.attribute("backup-path").as_string();
+
 				}
 
-				void get(const Request UDJAT_UNUSED(&request), Report &report) override {
+				void get(const Request &request, Report &report) override {
+
+					if(!request.getArgument("statistics").empty()) {
+						protocol->statistics(report);
+						return;
+					}
+
+					string terms = request.getArgument("search");
+					if(!terms.empty()) {
+						protocol->search(terms.c_str(),report);
+						return;
+					}
+
+					string file = request.getArgument("export");
+					if(!file.empty()) {
+
+						action(request);
+
+						// Written aside and renamed, an interrupted export doesn't replace a good one.
+						string path{backup(file)};
+						size_t rows;
+						{
+							ofstream out{path + ".tmp"};
+							if(!out) {
+								throw system_error(errno,system_category(),string{"Unable to create '"} + path + ".tmp'");
+							}
+							rows = protocol->dump(out);
+							if(!out) {
+								throw runtime_error(string{"Error writing '"} + path + ".tmp'");
+							}
+						}
+
+						if(std::rename((path + ".tmp").c_str(),path.c_str())) {
+							throw system_error(errno,system_category(),string{"Unable to rename '"} + path + ".tmp'");
+						}
+
+						info() << "Exported " << rows << " request(s) to '" << path << "'" << endl;
+
+						report.start("action","file","requests",nullptr);
+						report << string{"export"} << path << std::to_string(rows);
+						return;
+					}
+
+					file = request.getArgument("import");
+					if(!file.empty()) {
+
+						action(request);
+
+						string path{backup(file)};
+						ifstream in{path};
+						if(!in) {
+							throw system_error(errno,system_category(),string{"Unable to open '"} + path + "'");
+						}
+
+						size_t rows = protocol->load(in);
+
+						report.start("action","file","requests",nullptr);
+						report << string{"import"} << path << std::to_string(rows);
+						return;
+					}
+
 					protocol->get(report);
 				}
 
@@ -225,6 +345,18 @@
 			return make_shared<Agent>(protocol,node);
 		}
 
+		if(type == "sql-value") {
+			return ValueFactory(node);
+		}
+
+		if(type == "sql-recorder") {
+			return RecorderFactory(node);
+		}
+
+		if(type == "sql-replica") {
+			return ReplicaFactory(node);
+		}
+
 		return Udjat::Factory::AgentFactory(parent,node);
 
 	}
@@ -26,6 +26,7 @@
  #include <udjat/sqlite/database.h>
  #include <udjat/sqlite/sql.h>
  #include <udjat/sqlite/protocol.h>
+ #include <udjat/sqlite/logwriter.h>
  #include <udjat/agent.h>
  #include <string>
  #include <list>
@@ -47,6 +48,23 @@
 			// @brief List of active protocols.
 			std::vector<std::shared_ptr<Protocol>> protocols;
 
+			/// @brief Copy the console log to the database.
+			class LogSink {
+			private:
+				LogWriter writer;
+				std::vector<std::shared_ptr<std::streambuf>> captures;
+
+			public:
+				LogSink(std::shared_ptr<Database> database, const XML::Node &node);
+				~LogSink();
+			};
+
+			// @brief Active log sink.
+			std::shared_ptr<LogSink> logsink;
+
+			/// @brief Register the 'udjat_agents' virtual table on connection.
+			static void install_agent_table(sqlite3 *db);
+
 		public:
 			Module();
 			Module(const pugi::xml_node &node);
@@ -54,6 +72,15 @@
 
 			std::shared_ptr<Abstract::Agent> AgentFactory(const Abstract::Object &parent, const XML::Node &node) const;
 
+			/// @brief Create agent for a periodic query ('sql-value').
+			std::shared_ptr<Abstract::Agent> ValueFactory(const XML::Node &node) const;
+
+			/// @brief Create time-series recorder agent ('sql-recorder').
+			std::shared_ptr<Abstract::Agent> RecorderFactory(const XML::Node &node) const;
+
+			/// @brief Create standby replica agent ('sql-replica').
+			std::shared_ptr<Abstract::Agent> ReplicaFactory(const XML::Node &node) const;
+
 			bool push_back(const pugi::xml_node &node) override;
 
 		};
@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include "private.h"
+ #include <pugixml.hpp>
+ #include <udjat/agent.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/threadpool.h>
+ #include <udjat/sqlite/timeseries.h>
+ #include <cstdlib>
+ #include <string>
+ #include <vector>
+ #include <iostream>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Agent recording other agents values as time series, value is the number of stored samples.
+	class UDJAT_PRIVATE Recorder : public Udjat::Agent<unsigned int> {
+	private:
+		/// @brief Shared with the background trim.
+		std::shared_ptr<SQLite::TimeSeries> storage;
+
+		struct Source {
+			std::string path;
+			int64_t id;
+			std::string last;
+		};
+
+		std::vector<Source> sources;
+
+		/// @brief Maximum time, in seconds, a sample stays in memory.
+		time_t flush_interval = 60;
+		time_t last_flush = 0;
+
+		unsigned int recorded = 0;
+
+		/// @brief Samples dropped by the storage on the last check.
+		size_t dropped = 0;
+
+	public:
+		Recorder(std::shared_ptr<SQLite::Database> database, const XML::Node &node)
+			: Udjat::Agent<unsigned int>(node),
+				storage{make_shared<SQLite::TimeSeries>(database,Object::getAttribute(node, "sqlite", "batch-size", (unsigned int) 256))} {
+
+			flush_interval = Object::getAttribute(node, "sqlite", "flush-interval", (unsigned int) flush_interval);
+
+			{
+				unsigned int limit = Object::getAttribute(node, "sqlite", "buffer-limit", (unsigned int) 0);
+				if(limit) {
+					storage->capacity(limit);
+				}
+			}
+
+			static const struct {
+				SQLite::TimeSeries::Resolution resolution;
+				const char *attribute;
+			} retention[] = {
+				{ SQLite::TimeSeries::Raw,		"raw-retention"		},
+				{ SQLite::TimeSeries::Minute,	"minute-retention"	},
+				{ SQLite::TimeSeries::Hour,		"hour-retention"	},
+				{ SQLite::TimeSeries::Day,		"day-retention"		},
+			};
+
+			for(auto &it : retention) {
+				storage->retention(
+					it.resolution,
+					Object::getAttribute(node, "sqlite", it.attribute, (unsigned int) storage->retention(it.resolution))
+				);
+			}
+
+			for(auto child = node.child("series"); child; child = child.next_sibling("series")) {
+
+				const char *path = child.attribute("path").as_string();
+				if(!*path) {
+					throw runtime_error("Required attribute 'path' not found in series definition");
+				}
+
+				sources.push_back({path,storage->id(child.attribute("name").as_string(path)),""});
+
+			}
+
+			if(sources.empty()) {
+				warning() << "No series to record" << endl;
+			}
+
+		}
+
+		virtual ~Recorder() {
+			// The TimeSeries destructor flushes the remaining samples, after a running trim.
+		}
+
+		void start() override {
+			last_flush = time(0);
+			Udjat::Agent<unsigned int>::start(0);
+		}
+
+		bool refresh() override {
+
+			bool full = false;
+			auto root = Abstract::Agent::root();
+
+			for(Source &source : sources) {
+
+				auto agent = (root ? root->find(source.path.c_str(),false) : nullptr);
+				if(!agent) {
+					continue;
+				}
+
+				// Only record changes.
+				std::string value = agent->to_string();
+				if(value == source.last) {
+					continue;
+				}
+
+				char *end = nullptr;
+				double sample = strtod(value.c_str(),&end);
+				if(end == value.c_str()) {
+					continue;
+				}
+
+				source.last = value;
+				full |= storage->push_back(source.id,sample);
+
+			}
+
+			{
+				size_t dropped = storage->dropped();
+				if(dropped != this->dropped) {
+					warning() << (dropped - this->dropped) << " sample(s) dropped, the buffer is full" << endl;
+					this->dropped = dropped;
+				}
+			}
+
+			time_t now = time(0);
+			if(full || (now - last_flush) >= flush_interval) {
+				last_flush = now;
+				recorded += storage->flush();
+
+				// Expire old samples a few rows at a time, out of the agent update.
+				auto storage = this->storage;
+				ThreadPool::getInstance().push("sql-recorder",[storage]() {
+					try {
+						storage->trim();
+					} catch(const std::exception &e) {
+						cerr << "sqlite\tError removing expired samples: " << e.what() << endl;
+					}
+				});
+			}
+
+			return set(recorded);
+
+		}
+
+	};
+
+	std::shared_ptr<Abstract::Agent> SQLite::Module::RecorderFactory(const XML::Node &node) const {
+		return make_shared<Recorder>(database,node);
+	}
+
+ }
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include "private.h"
+ #include <pugixml.hpp>
+ #include <udjat/agent.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/intl.h>
+ #include <udjat/sqlite/replica.h>
+ #include <sstream>
+ #include <string>
+ #include <vector>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Agent keeping a standby copy of the database, value is the replication lag in seconds.
+	/// @details The state is an error when the standby diverged.
+	class UDJAT_PRIVATE Standby : public Udjat::Agent<unsigned int> {
+	private:
+		SQLite::Replica replica;
+
+		static std::vector<std::string> tables(const XML::Node &node) {
+
+			std::vector<std::string> tables;
+			std::istringstream list{node.attribute("tables").as_string()};
+			std::string table;
+
+			while(std::getline(list,table,',')) {
+				size_t from = table.find_first_not_of(" \t");
+				if(from != string::npos) {
+					tables.push_back(table.substr(from,table.find_last_not_of(" \t")-from+1));
+				}
+			}
+
+			if(tables.empty()) {
+				throw runtime_error("Required attribute 'tables' not found in replica definition");
+			}
+
+			return tables;
+		}
+
+		static const char * standby(const XML::Node &node) {
+			const char *filename = node.attribute("standby").as_string();
+			if(!*filename) {
+				throw runtime_error("Required attribute 'standby' not found in replica definition");
+			}
+			return filename;
+		}
+
+	public:
+		Standby(std::shared_ptr<SQLite::Database> database, const XML::Node &node)
+			: Udjat::Agent<unsigned int>(node), replica{database,standby(node),tables(node)} {
+		}
+
+		bool refresh() override {
+			replica.capture();
+			return set((unsigned int) replica.lag());
+		}
+
+		std::shared_ptr<Abstract::State> stateFromValue() const override {
+			if(replica.diverged()) {
+				return make_shared<Abstract::State>("diverged", Level::error, _( "The standby diverged, restart to rebuild it") );
+			}
+			return Udjat::Agent<unsigned int>::stateFromValue();
+		}
+
+	};
+
+	std::shared_ptr<Abstract::Agent> SQLite::Module::ReplicaFactory(const XML::Node &node) const {
+		return make_shared<Standby>(database,node);
+	}
+
+ }
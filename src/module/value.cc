@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include <config.h>
+ #include "private.h"
+ #include <pugixml.hpp>
+ #include <udjat/agent.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/string.h>
+ #include <udjat/tools/quark.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/sqlite/statement.h>
+ #include <mutex>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Agent whose value is the first column of a periodic query.
+	template <typename T>
+	class UDJAT_PRIVATE SQLValue : public Udjat::Agent<T> {
+	private:
+		std::mutex guard;
+
+		/// @brief The query, prepared once and reused on every refresh.
+		SQLite::Statement stmt;
+
+		std::shared_ptr<SQLite::Database> database;
+
+		static const char * query(const XML::Node &node) {
+			auto child = node.child("select");
+			if(!child) {
+				throw runtime_error("Required child 'select' not found");
+			}
+			String sql{child.child_value()};
+			sql.strip();
+			sql.expand(node);
+			return Quark(sql).c_str();
+		}
+
+		/// @brief Run query, no rows is the default value.
+		T fetch() {
+
+			T value{};
+
+			lock_guard<mutex> lock(guard);
+			stmt.reset();
+			if(stmt.step() == SQLITE_ROW) {
+				get(value);
+			}
+			stmt.reset();
+
+			return value;
+		}
+
+		void get(int &value) {
+			int64_t v;
+			stmt.get(0,v);
+			value = (int) v;
+		}
+
+		void get(unsigned int &value) {
+			int64_t v;
+			stmt.get(0,v);
+			value = (unsigned int) v;
+		}
+
+		void get(double &value) {
+			stmt.get(0,value);
+		}
+
+		void get(std::string &value) {
+			stmt.get(0,value);
+		}
+
+	public:
+		SQLValue(std::shared_ptr<SQLite::Database> db, const XML::Node &node) : Udjat::Agent<T>(node), stmt(db,query(node)), database(db) {
+
+			const char *table = node.attribute("table").as_string();
+			if(*table) {
+				// Refresh when the table changes instead of waiting for the timer.
+				database->insert(this,table,[this](const char *) {
+					this->sched_update(0);
+				});
+			}
+
+		}
+
+		virtual ~SQLValue() {
+			database->remove(this);
+		}
+
+		void start() override {
+			Udjat::Agent<T>::start(fetch());
+		}
+
+		bool refresh() override {
+			// Agent::set() only notifies listeners when the value has changed.
+			return this->set(fetch());
+		}
+
+	};
+
+	std::shared_ptr<Abstract::Agent> SQLite::Module::ValueFactory(const XML::Node &node) const {
+
+		String type{node,"value-type","integer"};
+
+		if(type == "integer") {
+			return make_shared<SQLValue<int>>(database,node);
+		}
+
+		if(type == "unsigned") {
+			return make_shared<SQLValue<unsigned int>>(database,node);
+		}
+
+		if(type == "real") {
+			return make_shared<SQLValue<double>>(database,node);
+		}
+
+		if(type == "string") {
+			return make_shared<SQLValue<std::string>>(database,node);
+		}
+
+		throw runtime_error(string{"Unexpected value-type '"} + type + "'");
+
+	}
+
+ }
@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ /// @brief Get the first value of a fetched result.
+ static std::string fetch(std::shared_ptr<SQLite::Database> db, const char *sql) {
+	auto result = db->fetch(sql);
+	if(result->rows.empty() || result->rows[0].empty()) {
+		return "";
+	}
+	return result->rows[0][0];
+ }
+
+ /// @brief Cached results are dropped when a table they read changes.
+ static SelfTest::Test invalidate{"result cache invalidation",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	db->cache(1024*1024);
+
+	db->exec("create table cached (id integer primary key, value text)");
+	db->exec("insert into cached (value) values ('1')");
+
+	check(fetch(db,"select count(*) from cached") == "1","The first fetch should read the table");
+	check(db->results.entries.size() == 1,"The result should be cached");
+
+	db->exec("insert into cached (value) values ('2')");
+	check(fetch(db,"select count(*) from cached") == "2","An insert should drop the cached result");
+
+	// Without a where clause SQLite would truncate the table without calling the update hook.
+	db->exec("delete from cached");
+	check(fetch(db,"select count(*) from cached") == "0","A truncating delete should drop the cached result");
+
+ }};
+
+ /// @brief WITHOUT ROWID tables change without calling the update hook.
+ static SelfTest::Test rowid{"result cache without rowid",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	db->cache(1024*1024);
+
+	db->exec("create table keys (name text primary key, value text) without rowid");
+	db->exec("insert into keys (name,value) values ('a','1')");
+
+	check(fetch(db,"select value from keys where name='a'") == "1","The first fetch should read the table");
+	check(db->results.entries.empty(),"Results reading WITHOUT ROWID tables should not be cached");
+
+	db->exec("update keys set value='2' where name='a'");
+	check(fetch(db,"select value from keys where name='a'") == "2","The changed value should be read");
+
+ }};
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ static const char *definition =
+	"<sql name='selftest' table='alerts' max-concurrency='8'>"
+		"<init>create table if not exists alerts (url text, action text, payload text)</init>"
+		"<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+		"<select>select rowid,url,action,payload from alerts order by rowid limit 1</select>"
+		"<delete>delete from alerts where rowid=?</delete>"
+	"</sql>";
+
+ /// @brief Dead letters written by parallel senders don't mix their bindings.
+ static SelfTest::Test concurrent{"parallel dead letters",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition);
+
+	static const size_t count = 64;
+
+	std::vector<SQLite::Protocol::Entry> entries;
+	for(size_t ix = 0; ix < count; ix++) {
+		entries.push_back({string{"http://host"} + std::to_string(ix) + "/","post",std::to_string(ix)});
+	}
+	protocol->enqueue(entries);
+
+	auto shard = protocol->shards[0];
+
+	// Started together, to make them race for the statements.
+	std::atomic<bool> start{false};
+
+	std::vector<std::thread> senders;
+	for(size_t ix = 0; ix < count; ix++) {
+		senders.emplace_back([&protocol,&shard,&entries,&start,ix]() {
+			while(!start) {
+				std::this_thread::yield();
+			}
+			SQLite::Protocol::Message message{(int64_t) ix+1,URL{entries[ix].url.c_str()},entries[ix].action,entries[ix].payload};
+			protocol->acknowledge(shard,{message.id},{{message,404}});
+		});
+	}
+	start = true;
+	for(auto &sender : senders) {
+		sender.join();
+	}
+
+	check(integer(db,"select count(*) from alerts") == 0,"Every request should be removed");
+	check(integer(db,"select count(distinct url) from alerts_dead") == (int64_t) count,"Every request should be buried once");
+
+	SQLite::Statement select(db,"select url,payload from alerts_dead");
+	while(select.step() == SQLITE_ROW) {
+		string url, payload;
+		select.get(0,url);
+		select.get(1,payload);
+		check(url == string{"http://host"} + payload + "/","The dead letter fields should be from the same request");
+	}
+	select.reset();
+
+ }};
+
+ /// @brief A failed acknowledge doesn't leave the request buried and queued.
+ static SelfTest::Test atomic{"dead letter with failed acknowledge",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition);
+
+	protocol->enqueue({{"http://localhost/1","post","1"}});
+	db->exec("create trigger alerts_keep before delete on alerts begin select raise(abort,'kept'); end");
+
+	SQLite::Protocol::Message message{1,URL{"http://localhost/1"},"post","1"};
+
+	bool thrown = false;
+	try {
+		protocol->acknowledge(protocol->shards[0],{message.id},{{message,404}});
+	} catch(const std::exception &) {
+		thrown = true;
+	}
+
+	check(thrown,"The acknowledge should fail");
+	check(integer(db,"select count(*) from alerts") == 1,"The request should stay queued");
+	check(integer(db,"select count(*) from alerts_dead") == 0,"The request should not be buried");
+
+ }};
@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+
+ /// @brief Values are read from the pending writes, the cache and the table.
+ static SelfTest::Test values{"key-value get, put and remove",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::KeyValue kv{db,"selftest"};
+
+	std::string value;
+	kv.put("a","1");
+	kv.put("b",std::string{"2\0two",5});
+	check(kv.get("a",value) && value == "1","A pending write should be read");
+
+	kv.flush();
+	kv.cache_size(0);
+	kv.cache_size(16);
+	check(kv.get("b",value) && value == std::string{"2\0two",5},"A flushed value should be read from the table");
+
+	kv.remove("a");
+	check(!kv.get("a",value),"A pending remove should hide the value");
+	kv.flush();
+	check(!kv.get("a",value),"A removed value should not be found");
+
+	std::vector<std::string> keys;
+	kv.put("prefix-1","1");
+	kv.put("prefix-2","2");
+	kv.scan("prefix-",[&keys](const std::string &key, const std::string &) {
+		keys.push_back(key);
+		return true;
+	});
+	check(keys.size() == 2 && keys[0] == "prefix-1","Scan should enumerate the keys with the prefix in order");
+
+ }};
+
+ /// @brief A value read while the key changes is not cached.
+ static void concurrent(SQLite::KeyValue::Durability durability) {
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::KeyValue kv{db,"selftest",durability};
+
+	// Readers evict each other, the key is read from the table while it changes.
+	kv.cache_size(1);
+	kv.put("other","other");
+	kv.flush();
+
+	std::atomic<bool> running{true};
+	std::vector<std::thread> readers;
+	for(size_t ix = 0; ix < 4; ix++) {
+		readers.emplace_back([&kv,&running](){
+			std::string value;
+			while(running) {
+				kv.get("key",value);
+				kv.get("other",value);
+			}
+		});
+	}
+
+	size_t stale = 0;
+	for(size_t ix = 0; ix < 300; ix++) {
+
+		kv.put("key",std::to_string(ix));
+		kv.flush();
+		kv.remove("key");
+		kv.flush();
+
+		std::this_thread::yield();
+
+		// The key was removed, a cached value is stale.
+		lock_guard<mutex> lock(kv.guard);
+		if(kv.cache.index.count("key")) {
+			stale++;
+		}
+
+	}
+
+	running = false;
+	for(auto &reader : readers) {
+		reader.join();
+	}
+
+	std::string value;
+	check(!stale,"A removed key should not be cached by a concurrent get");
+	check(!kv.get("key",value),"A removed key should not be found");
+
+ }
+
+ static SelfTest::Test batched{"key-value concurrent get, batched",[](){
+	concurrent(SQLite::KeyValue::Batched);
+ }};
+
+ static SelfTest::Test immediate{"key-value concurrent get, immediate",[](){
+	concurrent(SQLite::KeyValue::Immediate);
+ }};
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ /// @brief Wait for the writer thread, true if the query got the expected value.
+ static bool wait(std::shared_ptr<SQLite::Database> db, const char *sql, int64_t expected) {
+	for(size_t ix = 0; ix < 150; ix++) {
+		if(integer(db,sql) == expected) {
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return false;
+ }
+
+ /// @brief Records are written in batches, the pending ones when the writer ends.
+ static SelfTest::Test batches{"log writer batches",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+
+	{
+		SQLite::LogWriter writer{db,2,0};
+
+		writer.write(Logger::Info,"selftest","first alert");
+		writer.write(Logger::Warning,"selftest","second alert");
+
+		// The batch is full, written before the delay.
+		check(wait(db,"select count(*) from log",2),"A full batch should be written by the writer thread");
+
+		writer.write(Logger::Error,"selftest","third record");
+	}
+
+	check(integer(db,"select count(*) from log") == 3,"Pending records should be written when the writer ends");
+	check(integer(db,"select level from log where id=3") == (int64_t) Logger::Error,"The record level should be stored");
+
+ }};
+
+ /// @brief Search uses the full text index, newest first.
+ static SelfTest::Test search{"log writer search",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::LogWriter writer{db,1,0};
+
+	writer.write(Logger::Info,"selftest","first alert");
+	writer.write(Logger::Info,"selftest","other record");
+	writer.write(Logger::Info,"selftest","second alert");
+	check(wait(db,"select count(*) from log",3),"The records should be written");
+
+	std::vector<std::string> messages;
+	writer.search("alert",[&messages](time_t, Logger::Level, const char *domain, const char *message) {
+		check(!strcmp(domain,"selftest"),"The record domain should be stored");
+		messages.push_back(message);
+		return true;
+	});
+
+	if(writer.indexed) {
+		check(messages.size() == 2 && messages[0] == "second alert" && messages[1] == "first alert","Search should find the matching records, newest first");
+	}
+
+ }};
+
+ /// @brief Expired records are removed with their index entries.
+ static SelfTest::Test retention{"log writer retention",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::LogWriter writer{db,1,60};
+
+	db->exec("insert into log (level,domain,timestamp,message) values (0,'selftest',0,'expired alert')");
+	writer.write(Logger::Info,"selftest","current alert");
+
+	check(wait(db,"select count(*) from log where timestamp = 0",0),"Expired records should be removed");
+	check(integer(db,"select count(*) from log") == 1,"Current records should be kept");
+
+	if(writer.indexed) {
+		size_t found = 0;
+		writer.search("expired",[&found](time_t, Logger::Level, const char *, const char *) {
+			found++;
+			return true;
+		});
+		check(!found,"Expired records should be removed from the index");
+	}
+
+ }};
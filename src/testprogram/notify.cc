@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+
+ /// @brief Listeners are called after commit, once by transaction.
+ static SelfTest::Test commit{"table change notifications",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	db->exec("create table events (id integer primary key, value text)");
+
+	size_t calls = 0;
+	db->insert(&calls,"events",[&calls](const char *) {
+		calls++;
+	});
+
+	db->exec("insert into events (value) values ('1')");
+	check(calls == 1,"An insert should be notified");
+
+	{
+		SQLite::Database::Transaction transaction{db};
+		db->exec("insert into events (value) values ('2')");
+		db->exec("insert into events (value) values ('3')");
+		check(calls == 1,"Changes should be notified only after commit");
+		transaction.commit();
+	}
+	check(calls == 2,"The changes of a transaction should be coalesced");
+
+	{
+		SQLite::Database::Transaction transaction{db};
+		db->exec("insert into events (value) values ('4')");
+	}
+	check(calls == 2,"A rolled back change should not be notified");
+
+	// Without a where clause SQLite would truncate the table without calling the update hook.
+	db->exec("delete from events");
+	check(calls == 3,"A truncating delete should be notified");
+
+	db->remove(&calls);
+	db->exec("insert into events (value) values ('5')");
+	check(calls == 3,"A removed listener should not be called");
+
+ }};
+
+ /// @brief Changes on WITHOUT ROWID tables can't be tracked, listening to them fails.
+ static SelfTest::Test rowid{"table change notifications without rowid",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	db->exec("create table keys (name text primary key, value text) without rowid");
+
+	bool failed = false;
+	try {
+		db->insert(&failed,"keys",[](const char *) {
+		});
+	} catch(const std::exception &) {
+		failed = true;
+	}
+
+	check(failed,"Listening to a WITHOUT ROWID table should fail");
+	check(db->changes.listeners.empty(),"The listener should not be inserted");
+
+ }};
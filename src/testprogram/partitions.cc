@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ static const char *definition =
+	"<sql name='selftest' table='alerts' partition-rows='2'>"
+		"<init>create table if not exists alerts (id integer primary key, url text, action text, payload text)</init>"
+		"<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+		"<select>select id,url,action,payload from alerts order by id limit 1</select>"
+		"<delete>delete from alerts where id=?</delete>"
+	"</sql>";
+
+ /// @brief Run the partition maintenance now.
+ static void maintain(SQLite::Protocol &protocol) {
+	protocol.partition.checked = 0;
+	protocol.maintain();
+ }
+
+ /// @brief Full partitions are rotated, the delivered ones dropped.
+ static SelfTest::Test rotate{"partitioned queue rotation",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition);
+
+	check(integer(db,"select count(*) from sqlite_master where type='view' and name='alerts'") == 1,"The queue should be a view on the partitions");
+
+	protocol->enqueue({
+		{"http://localhost/1","post","1"},
+		{"http://localhost/2","post","2"},
+		{"http://localhost/3","post","3"}
+	});
+
+	maintain(*protocol);
+	check(integer(db,"select count(*) from udjat_partitions") == 2,"A full partition should start a new one");
+
+	protocol->enqueue({{"http://localhost/4","post","4"}});
+	check(integer(db,"select count(*) from alerts_3") == 1,"Inserts should go to the current partition");
+	check(integer(db,"select max(id) from alerts") == 4,"Keys should continue from the previous partition");
+
+	auto shard = protocol->shards[0];
+	protocol->acknowledge(shard,{1,2});
+
+	maintain(*protocol);
+	check(integer(db,"select count(*) from alerts_0") == 3,"A partition with pending requests should be kept");
+	check(integer(db,"select count(*) from alerts") == 2,"Delivered requests should be hidden");
+
+	protocol->acknowledge(shard,{3});
+
+	maintain(*protocol);
+	check(integer(db,"select count(*) from udjat_partitions") == 1,"A delivered partition should be dropped");
+	check(integer(db,"select count(*) from sqlite_master where name='alerts_0'") == 0,"The delivered partition table should be dropped");
+	check(integer(db,"select count(*) from alerts_delivered") == 0,"The delivered keys should be dropped with the partition");
+	check(integer(db,"select id from alerts") == 4,"The pending request should be kept");
+
+ }};
+
+ /// @brief Reloading a partitioned queue keeps the partitions.
+ static SelfTest::Test reload{"partitioned queue reload",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition);
+
+	protocol->enqueue({
+		{"http://localhost/1","post","1"},
+		{"http://localhost/2","post","2"}
+	});
+	maintain(*protocol);
+
+	SelfTest::reload(*protocol,definition);
+
+	check(integer(db,"select count(*) from udjat_partitions") == 2,"The partitions should be kept");
+	protocol->enqueue({{"http://localhost/3","post","3"}});
+	check(integer(db,"select count(*) from alerts") == 3 && integer(db,"select max(id) from alerts") == 3,"Requests should be queued after reload");
+
+ }};
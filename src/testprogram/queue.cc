@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+
+ /// @brief Leased entries are hidden until acknowledged or released.
+ static SelfTest::Test lease{"typed queue lease, ack and release",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::Queue<int> queue{db,"selftest"};
+
+	int64_t first = queue.push_back(1);
+	queue.push_back(std::vector<int>{2,3});
+	check(queue.size() == 3,"The queue should have 3 entries");
+
+	auto leased = queue.lease(2,60);
+	check(leased.size() == 2 && leased[0].id == first && leased[0].value == 1 && leased[1].value == 2,"The oldest entries should be leased first");
+	check(leased[0].attempts == 1,"The first lease should be the first attempt");
+	check(queue.leased() == 2,"Leased entries should be counted");
+
+	auto next = queue.lease(10,60);
+	check(next.size() == 1 && next[0].value == 3,"Leased entries should be hidden");
+
+	queue.ack({leased[0].id});
+	queue.release({leased[1].id});
+
+	auto again = queue.lease(10,60);
+	check(again.size() == 1 && again[0].value == 2 && again[0].attempts == 2,"Released entries should be leased again");
+	check(queue.size() == 2,"Acknowledged entries should be removed");
+
+	check(queue.push_back(4) > again[0].id,"New entries should get new ids");
+
+ }};
+
+ /// @brief Serialized values may have embedded NULs.
+ static SelfTest::Test binary{"typed queue binary values",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::Queue<std::string> queue{db,"selftest"};
+
+	std::string value{"head\0tail",9};
+	queue.push_back(value);
+	queue.push_back(std::vector<std::string>{value});
+
+	auto leased = queue.lease(10,60);
+	check(leased.size() == 2,"Both entries should be leased");
+	check(leased[0].value == value && leased[1].value == value,"Binary values should be read with all their bytes");
+
+ }};
+
+ /// @brief A value that can't be converted doesn't block the rest of the batch.
+ static SelfTest::Test invalid{"typed queue invalid values",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+
+	SQLite::Queue<std::string>{db,"selftest"}.push_back(std::vector<std::string>{"1","invalid","3","4"});
+	SQLite::Queue<int> queue{db,"selftest"};
+
+	std::vector<SQLite::BasicQueue::Entry> rejected;
+	auto leased = queue.lease(3,60,&rejected);
+	check(leased.size() == 2 && leased[0].value == 1 && leased[1].value == 3,"The valid entries should be leased");
+	check(rejected.size() == 1 && rejected[0].value == "invalid","The invalid entry should be reported");
+
+	auto next = queue.lease(3,60);
+	check(next.size() == 1 && next[0].value == 4,"The invalid entry should stay leased, not block the next ones");
+
+	queue.ack({rejected[0].id});
+	queue.release({leased[0].id});
+	auto again = queue.lease(3,60);
+	check(again.size() == 1 && again[0].value == 1,"An acknowledged invalid entry should be removed");
+
+ }};
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ /// @brief Get the queue definition with an extra 'init' statement and select.
+ static std::string definition(const char *init, const char *select) {
+	return
+		string{"<sql name='selftest' table='alerts'>"}
+			+ "<init>create table if not exists alerts (url text, action text, payload text)</init>"
+			+ "<init>" + init + "</init>"
+			+ "<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+			+ "<select>" + select + "</select>"
+			+ "<delete>delete from alerts where rowid=?</delete>"
+		+ "</sql>";
+ }
+
+ static const char *select_sql = "select rowid,url,action,payload from alerts order by rowid limit 1";
+
+ /// @brief The 'init' statements of a failed reload are rolled back.
+ static SelfTest::Test init{"reload rolls back init",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition("create table if not exists first (id integer)",select_sql).c_str());
+
+	bool failed = false;
+	try {
+		SelfTest::reload(*protocol,definition("create table if not exists second (id integer)","select invalid from alerts").c_str());
+	} catch(const std::exception &) {
+		failed = true;
+	}
+
+	check(failed,"The invalid definition should fail the reload");
+	check(integer(db,"select count(*) from sqlite_master where name='second'") == 0,"The init statements should be rolled back");
+	check(strstr(protocol->select,"invalid") == nullptr,"The active statements should be kept");
+
+	SelfTest::reload(*protocol,definition("create table if not exists second (id integer)",select_sql).c_str());
+	check(integer(db,"select count(*) from sqlite_master where name='second'") == 1,"The init statements should run on reload");
+
+ }};
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+#ifdef HAVE_SQLITE_SESSION
+
+ /// @brief Wait for the standby to apply the queued changesets.
+ static void wait(const SQLite::Replica &replica) {
+	for(size_t ix = 0; ix < 500 && replica.pending(); ix++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+ }
+
+ /// @brief A changeset failing on the standby stops the replication.
+ static SelfTest::Test diverged{"replica diverged standby",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	db->exec("create table items (id integer primary key, value text)");
+
+	string filename{SelfTest::filename("standby.db")};
+	SQLite::Replica replica{db,filename.c_str(),{"items"}};
+	auto standby = make_shared<SQLite::Database>(filename.c_str());
+
+	db->exec("insert into items (value) values ('1')");
+	check(replica.capture() > 0,"The insert should be captured");
+	wait(replica);
+	check(integer(standby,"select count(*) from items") == 1,"The insert should be applied to the standby");
+	check(!replica.diverged(),"The standby should be in sync");
+
+	standby->exec("create trigger reject before insert on items begin select raise(abort,'rejected'); end");
+
+	db->exec("insert into items (value) values ('2')");
+	replica.capture();
+	wait(replica);
+
+	check(replica.diverged(),"A failed changeset should be reported");
+	check(replica.pending() == 0,"The changesets should not be kept after the failure");
+
+	standby->exec("drop trigger reject");
+
+	db->exec("insert into items (value) values ('3')");
+	check(replica.capture() == 0,"Changes should not be captured after the failure");
+	check(integer(standby,"select count(*) from items") == 1,"Nothing should be applied after the failure");
+	check(replica.diverged(),"The standby should stay diverged");
+
+ }};
+
+#endif // HAVE_SQLITE_SESSION
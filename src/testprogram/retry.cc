@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+ #include <cerrno>
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+
+ /// @brief Only HTTP client errors carry a status, errnos are failures.
+ static SelfTest::Test classify{"send result classes",[](){
+
+	class Category : public std::error_category {
+	public:
+		const char * name() const noexcept override {
+			return "selftest";
+		}
+
+		std::string message(int code) const override {
+			return std::to_string(code);
+		}
+
+	} category;
+
+	int status;
+
+	check(SQLite::Protocol::classify(std::error_code(ECONNREFUSED,std::system_category()),status) == SQLite::Protocol::Failure && !status,"A refused connection should be a failure");
+	check(SQLite::Protocol::classify(std::error_code(ETIMEDOUT,std::generic_category()),status) == SQLite::Protocol::Failure && !status,"A timeout should be a failure");
+	check(SQLite::Protocol::classify(std::error_code(204,category),status) == SQLite::Protocol::Success && status == 204,"204 should be a success");
+	check(SQLite::Protocol::classify(std::error_code(404,category),status) == SQLite::Protocol::ClientError && status == 404,"404 should be a client error");
+	check(SQLite::Protocol::classify(std::error_code(503,category),status) == SQLite::Protocol::ServerError && status == 503,"503 should be a server error");
+	check(SQLite::Protocol::classify(std::error_code(7,category),status) == SQLite::Protocol::Failure && !status,"Codes out of the HTTP range should be failures");
+
+ }};
+
+ /// @brief The <on> children change the defaults by class and by status.
+ static SelfTest::Test policies{"send result policies",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(
+		db,
+		"<sql name='selftest' table='alerts'>"
+			"<init>create table if not exists alerts (url text, action text, payload text)</init>"
+			"<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+			"<select>select rowid,url,action,payload from alerts order by rowid limit 1</select>"
+			"<delete>delete from alerts where rowid=?</delete>"
+			"<on status='4xx' action='retry' />"
+			"<on status='404' action='delete' />"
+		"</sql>"
+	);
+
+	check(protocol->policy.results[SQLite::Protocol::ClientError] == SQLite::Protocol::Retry,"The class action should be set");
+	check(protocol->policy.status[404] == SQLite::Protocol::Delete,"The status action should be set");
+	check(protocol->policy.status[429] == SQLite::Protocol::Retry,"The default status actions should be kept");
+	check(protocol->policy.results[SQLite::Protocol::Redirect] == SQLite::Protocol::DeadLetter,"The default class actions should be kept");
+
+	bool thrown = false;
+	try {
+		SelfTest::protocol(
+			db,
+			"<sql name='selftest' table='alerts'>"
+				"<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+				"<select>select rowid,url,action,payload from alerts order by rowid limit 1</select>"
+				"<delete>delete from alerts where rowid=?</delete>"
+				"<on status='600' action='delete' />"
+			"</sql>"
+		);
+	} catch(const std::exception &) {
+		thrown = true;
+	}
+	check(thrown,"An invalid status should be rejected");
+
+ }};
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+ #include <chrono>
+ #include <filesystem>
+
+ using namespace std;
+ using namespace Udjat;
+
+ namespace SelfTest {
+
+	/// @brief Registered tests, in link order.
+	static std::vector<std::pair<const char *, void (*)()>> & tests() {
+		static std::vector<std::pair<const char *, void (*)()>> tests;
+		return tests;
+	}
+
+	Test::Test(const char *name, void (*method)()) {
+		tests().emplace_back(name,method);
+	}
+
+	void check(bool condition, const char *message) {
+		if(!condition) {
+			throw runtime_error(message);
+		}
+	}
+
+	/// @brief Folder for the test databases.
+	static const std::filesystem::path & folder() {
+		static std::filesystem::path folder;
+		if(folder.empty()) {
+			folder = std::filesystem::temp_directory_path() / (string{"udjat-sqlite-selftest-"} + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()));
+			std::filesystem::create_directories(folder);
+		}
+		return folder;
+	}
+
+	std::string filename(const char *name) {
+		return (folder() / name).string();
+	}
+
+	int64_t integer(std::shared_ptr<SQLite::Database> db, const char *sql) {
+		int64_t value = 0;
+		SQLite::Statement select(db,sql);
+		if(select.step() == SQLITE_ROW) {
+			select.get(0,value);
+		}
+		select.reset();
+		return value;
+	}
+
+	std::shared_ptr<SQLite::Protocol> protocol(std::shared_ptr<SQLite::Database> db, const char *xml) {
+		pugi::xml_document document;
+		if(!document.load_string(xml)) {
+			throw runtime_error("Invalid protocol definition");
+		}
+		return make_shared<SQLite::Protocol>(db,document.document_element());
+	}
+
+	void reload(SQLite::Protocol &protocol, const char *xml) {
+		pugi::xml_document document;
+		if(!document.load_string(xml)) {
+			throw runtime_error("Invalid protocol definition");
+		}
+		protocol.reload(document.document_element());
+	}
+
+ }
+
+ int selftest() {
+
+	int failed = 0;
+
+	for(auto &test : SelfTest::tests()) {
+		try {
+			test.second();
+			cout << "selftest\t" << test.first << ": ok" << endl;
+		} catch(const std::exception &e) {
+			cerr << "selftest\t" << test.first << ": " << e.what() << endl;
+			failed++;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(SelfTest::folder(),ec);
+
+	cout << "selftest\t" << (SelfTest::tests().size() - failed) << " of " << SelfTest::tests().size() << " test(s) passed" << endl;
+
+	return failed ? 1 : 0;
+
+ }
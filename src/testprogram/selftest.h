@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Self-test declarations, used only by the test program.
+  *
+  * The tests check the library internals: the members of the module classes are
+  * made public here, the installed headers keep their access control.
+  */
+
+ #pragma once
+
+ #include <config.h>
+
+ // System and libudjat headers first, they are not opened.
+ #include <atomic>
+ #include <chrono>
+ #include <condition_variable>
+ #include <cstring>
+ #include <deque>
+ #include <functional>
+ #include <iostream>
+ #include <list>
+ #include <map>
+ #include <memory>
+ #include <mutex>
+ #include <set>
+ #include <sstream>
+ #include <stdexcept>
+ #include <string>
+ #include <system_error>
+ #include <thread>
+ #include <unordered_map>
+ #include <vector>
+ #include <sqlite3.h>
+ #include <pugixml.hpp>
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/protocol.h>
+ #include <udjat/tools/url.h>
+
+ #define private public
+ #define protected public
+
+ #include <udjat/sqlite/database.h>
+ #include <udjat/sqlite/statement.h>
+ #include <udjat/sqlite/protocol.h>
+ #include <udjat/sqlite/queue.h>
+ #include <udjat/sqlite/replica.h>
+ #include <udjat/sqlite/keyvalue.h>
+ #include <udjat/sqlite/logwriter.h>
+ #include <udjat/sqlite/timeseries.h>
+
+ #undef protected
+ #undef private
+
+ namespace SelfTest {
+
+	/// @brief Register a test, run by 'udjat --self-test'.
+	struct Test {
+		Test(const char *name, void (*method)());
+	};
+
+	/// @brief Throw runtime_error with message if condition is false.
+	void check(bool condition, const char *message);
+
+	/// @brief Get the first column of the first row, 0 if there's none.
+	int64_t integer(std::shared_ptr<Udjat::SQLite::Database> db, const char *sql);
+
+	/// @brief Get a file name on the test folder, removed when the tests end.
+	std::string filename(const char *name);
+
+	/// @brief Get a queue protocol from an XML definition.
+	std::shared_ptr<Udjat::SQLite::Protocol> protocol(std::shared_ptr<Udjat::SQLite::Database> db, const char *xml);
+
+	/// @brief Reload a queue protocol from an XML definition.
+	void reload(Udjat::SQLite::Protocol &protocol, const char *xml);
+
+ }
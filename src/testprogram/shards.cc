@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ /// @brief Get the queue definition with the number of shards.
+ static std::string definition(unsigned int shards) {
+	return
+		string{"<sql name='selftest' table='alerts' shards='"} + std::to_string(shards) + "'>"
+			"<init>create table if not exists alerts (url text, action text, payload text)</init>"
+			"<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+			"<select>select rowid,url,action,payload from alerts order by rowid limit 1</select>"
+			"<delete>delete from alerts where rowid=?</delete>"
+		"</sql>";
+ }
+
+ /// @brief Count the listeners of the protocol on the database.
+ static size_t listeners(const SQLite::Protocol &protocol, std::shared_ptr<SQLite::Database> database) {
+	lock_guard<mutex> lock(database->changes.guard);
+	size_t count = 0;
+	for(auto &listener : database->changes.listeners) {
+		if(listener.id == &protocol) {
+			count++;
+		}
+	}
+	return count;
+ }
+
+ /// @brief Get an URL routed to the shard database.
+ static std::string routed(const SQLite::Protocol &protocol, std::shared_ptr<SQLite::Database> database) {
+	for(size_t ix = 0; ix < 1000; ix++) {
+		string url{string{"http://host-"} + std::to_string(ix) + "/alert"};
+		if(protocol.route(url.c_str()) == database) {
+			return url;
+		}
+	}
+	throw runtime_error("No destination routed to the shard");
+ }
+
+ /// @brief A batch spanning shards is queued on all of them or on none.
+ static SelfTest::Test enqueue{"sharded enqueue is atomic",[](){
+
+	auto db = make_shared<SQLite::Database>(SelfTest::filename("enqueue.db").c_str());
+	auto protocol = SelfTest::protocol(db,definition(2).c_str());
+
+	auto first = protocol->shards[0].database;
+	auto second = protocol->shards[1].database;
+
+	string url[] = { routed(*protocol,first), routed(*protocol,second) };
+
+	// The second shard is locked after the first one, its insert fails after the first shard got the rows.
+	second->exec("create trigger reject before insert on alerts when instr(new.payload,'reject') begin select raise(abort,'rejected'); end");
+
+	bool failed = false;
+	try {
+		protocol->enqueue({
+			{url[0].c_str(),"post","1"},
+			{url[1].c_str(),"post","reject"}
+		});
+	} catch(const std::exception &) {
+		failed = true;
+	}
+
+	check(failed,"The rejected insert should fail the batch");
+	check(integer(first,"select count(*) from alerts") == 0,"A failed batch should leave no rows on the other shards");
+	check(integer(second,"select count(*) from alerts") == 0,"A failed batch should leave no rows on the failed shard");
+
+	protocol->enqueue({
+		{url[0].c_str(),"post","1"},
+		{url[1].c_str(),"post","2"}
+	});
+
+	check(integer(first,"select count(*) from alerts") == 1 && integer(second,"select count(*) from alerts") == 1,"A batch should be queued on every shard");
+
+ }};
+
+ /// @brief An empty queue can change the number of shards on reload.
+ static SelfTest::Test shrink{"sharded queue shrink on reload",[](){
+
+	auto db = make_shared<SQLite::Database>(SelfTest::filename("shrink.db").c_str());
+	auto protocol = SelfTest::protocol(db,definition(2).c_str());
+
+	auto surplus = protocol->shards[1].database;
+	string url{routed(*protocol,surplus)};
+
+	// An invalid definition is found after the shards are checked, nothing should change.
+	string invalid{definition(1)};
+	invalid.replace(invalid.find("order by rowid"),14,"order by invalid");
+
+	bool failed = false;
+	try {
+		SelfTest::reload(*protocol,invalid.c_str());
+	} catch(const std::exception &) {
+		failed = true;
+	}
+
+	check(failed,"The invalid definition should fail the reload");
+	check(protocol->shards.size() == 2 && listeners(*protocol,surplus) == 1,"A failed reload should keep the shards listened");
+
+	SelfTest::reload(*protocol,definition(1).c_str());
+
+	check(protocol->shards.size() == 1,"The queue should have one shard");
+	check(listeners(*protocol,surplus) == 0,"The dropped shard should not be listened");
+	check(listeners(*protocol,db) == 1,"The kept shard should be listened");
+
+	protocol->enqueue({{url.c_str(),"post","1"}});
+	check(integer(db,"select count(*) from alerts") == 1,"Requests should be queued on the kept shard");
+
+ }};
+
+ /// @brief A queue with requests keeps its shards when the reload fails.
+ static SelfTest::Test pending{"sharded queue shrink with requests",[](){
+
+	auto db = make_shared<SQLite::Database>(SelfTest::filename("pending.db").c_str());
+	auto protocol = SelfTest::protocol(db,definition(2).c_str());
+
+	auto second = protocol->shards[1].database;
+	protocol->enqueue({{routed(*protocol,second).c_str(),"post","1"}});
+
+	bool failed = false;
+	try {
+		SelfTest::reload(*protocol,definition(1).c_str());
+	} catch(const std::exception &) {
+		failed = true;
+	}
+
+	check(failed,"The number of shards should not change with requests queued");
+	check(protocol->shards.size() == 2 && protocol->shards[1].database == second,"The active shards should be kept");
+	check(listeners(*protocol,second) == 1,"The active shards should still be listened");
+
+ }};
+
+ /// @brief The shards from the last run are checked and closed when the number of shards is reduced.
+ static SelfTest::Test reopen{"sharded queue reopened with fewer shards",[](){
+
+	string filename{SelfTest::filename("reopen.db")};
+
+	{
+		auto db = make_shared<SQLite::Database>(filename.c_str());
+		SelfTest::protocol(db,definition(2).c_str());
+	}
+
+	auto db = make_shared<SQLite::Database>(filename.c_str());
+	auto protocol = SelfTest::protocol(db,definition(1).c_str());
+
+	check(protocol->shards.size() == 1,"The queue should have one shard");
+	check(integer(db,"select shards from udjat_shards") == 1,"The number of shards should be stored");
+
+ }};
+
+ /// @brief Requests to a destination are queued on one shard, keeping their order.
+ static SelfTest::Test route{"sharded queue routing",[](){
+
+	auto db = make_shared<SQLite::Database>(SelfTest::filename("route.db").c_str());
+	auto protocol = SelfTest::protocol(db,definition(4).c_str());
+
+	check(protocol->shards.size() == 4,"The queue should have 4 shards");
+	check(protocol->shards[0].database == db,"The first shard should be the queue database");
+	check(protocol->shards[3].database->filename() == SelfTest::filename("route-3.db"),"The shards should be on numbered files");
+
+	auto shard = protocol->route("http://host-1/alert");
+	check(protocol->route("http://HOST-1/alert") == shard,"The host should not be case sensitive");
+	check(protocol->route("https://host-1/other") == protocol->route("http://host-1/other"),"The scheme should not change the shard");
+	check(protocol->route("http://host-1/a") == shard && protocol->route("http://host-1/b#c") == shard,"The path should not change the shard");
+
+	std::set<std::shared_ptr<SQLite::Database>> used;
+	for(size_t ix = 0; ix < 64; ix++) {
+		used.insert(protocol->route((string{"http://host-"} + std::to_string(ix)).c_str()));
+	}
+	check(used.size() == 4,"Destinations should be spread on all shards");
+
+	protocol->enqueue({
+		{"http://host-1/1","post","1"},
+		{"http://host-1/2","post","2"}
+	});
+	check(integer(shard,"select count(*) from alerts") == 2,"Requests to a destination should be on its shard");
+
+ }};
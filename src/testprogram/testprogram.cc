@@ -28,14 +28,23 @@
  #include <udjat/module.h>
  #include <iostream>
  #include <memory>
+ #include <cstring>
 
  using namespace std;
  using namespace Udjat;
 
+ /// @brief Run the self-tests.
+ /// @return 0 if all of them passed.
+ int selftest();
+
 //---[ Implement ]------------------------------------------------------------------------------------------
 
 int main(int argc, char **argv) {
 
+	if(argc > 1 && !strcmp(argv[1],"--self-test")) {
+		return selftest();
+	}
+
 	class Service : public SystemService {
 	protected:
 		/// @brief Initialize service.
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ /// @brief Samples are buffered and written by flush().
+ static SelfTest::Test samples{"time series samples",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::TimeSeries ts{db,3};
+
+	int64_t id = ts.id("cpu");
+	check(ts.id("cpu") == id,"A series should keep its id");
+
+	time_t now = time(0);
+	check(!ts.push_back(id,1,now-2),"The buffer should not be full");
+	check(!ts.push_back(id,2,now-1),"The buffer should not be full");
+	check(ts.push_back(id,3,now),"The buffer should be full on the batch size");
+	ts.push_back(id,4,now);
+
+	check(integer(db,"select count(*) from ts_samples") == 0,"Samples should be buffered until flush");
+	check(ts.flush() == 4 && ts.size() == 0,"Flush should write the buffered samples");
+	check(integer(db,"select count(*) from ts_samples") == 3,"A second sample on the same second should be ignored");
+
+	std::vector<double> values;
+	ts.get("cpu",now-10,now,100,[&values](time_t, double, double, double avg, size_t) {
+		values.push_back(avg);
+	});
+	check(values.size() == 3 && values[0] == 1 && values[2] == 3,"The samples should be read in time order");
+
+	size_t count = 0;
+	ts.get("unknown",now-10,now,100,[&count](time_t, double, double, double, size_t) {
+		count++;
+	});
+	check(!count && integer(db,"select count(*) from ts_series") == 1,"An unknown series should have no values and not be created");
+
+ }};
+
+ /// @brief Samples are kept when the flush fails, up to the buffer limit.
+ static SelfTest::Test overflow{"time series buffer limit",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::TimeSeries ts{db,4};
+	ts.capacity(8);
+
+	int64_t id = ts.id("cpu");
+	time_t now = time(0);
+
+	db->exec("create trigger reject before insert on ts_samples begin select raise(abort,'rejected'); end");
+
+	for(time_t ix = 0; ix < 6; ix++) {
+		ts.push_back(id,(double) ix,now-ix);
+	}
+
+	bool failed = false;
+	try {
+		ts.flush();
+	} catch(const std::exception &) {
+		failed = true;
+	}
+	check(failed && ts.size() == 6,"A failed flush should keep the samples");
+
+	for(time_t ix = 6; ix < 10; ix++) {
+		ts.push_back(id,(double) ix,now-ix);
+	}
+	check(ts.size() == 8 && ts.dropped() == 2,"The oldest samples should be dropped beyond the limit");
+
+	db->exec("drop trigger reject");
+	check(ts.flush() == 8 && integer(db,"select count(*) from ts_samples") == 8,"The kept samples should be written on the next flush");
+
+ }};
+
+ /// @brief Each flush updates the minute, hour and day rollups.
+ static SelfTest::Test rollups{"time series rollups",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::TimeSeries ts{db,16};
+
+	int64_t id = ts.id("cpu");
+	time_t hour = (time(0) / 3600) * 3600;
+
+	ts.push_back(id,1,hour);
+	ts.push_back(id,2,hour+1);
+	ts.flush();
+	ts.push_back(id,3,hour+61);
+	ts.flush();
+
+	check(integer(db,"select samples from ts_hours") == 3 && integer(db,"select maximum from ts_hours") == 3,"The hour rollup should be updated by every flush");
+
+	std::vector<std::tuple<time_t,double,double,double,size_t>> values;
+	auto resolution = ts.get("cpu",hour,hour+3600,60,[&values](time_t timestamp, double min, double max, double avg, size_t count) {
+		values.emplace_back(timestamp,min,max,avg,count);
+	});
+
+	check(resolution == SQLite::TimeSeries::Minute,"A one hour range on 60 points should be read by minute");
+	check(values.size() == 2,"There should be one value by minute with samples");
+	check(values[0] == std::make_tuple(hour,1.0,2.0,1.5,(size_t) 2),"The first minute should aggregate its samples");
+	check(values[1] == std::make_tuple(hour+60,3.0,3.0,3.0,(size_t) 1),"The second minute should have one sample");
+
+ }};
+
+ /// @brief Expired values are removed by resolution, reads move to a coarser one.
+ static SelfTest::Test retention{"time series retention",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	SQLite::TimeSeries ts{db,16};
+	ts.retention(SQLite::TimeSeries::Raw,600);
+
+	int64_t id = ts.id("cpu");
+	time_t now = time(0);
+
+	ts.push_back(id,1,now-7200);
+	ts.push_back(id,2,now);
+	ts.flush();
+
+	check(ts.trim() == 1,"The expired raw sample should be removed");
+	check(integer(db,"select count(*) from ts_samples") == 1,"The current raw sample should be kept");
+	check(integer(db,"select sum(samples) from ts_minutes") == 2,"The rollups should be kept by their own retention");
+
+	check(ts.resolution(now-60,now,1000) == SQLite::TimeSeries::Raw,"A recent range should be read from the raw samples");
+	check(ts.resolution(now-7200,now,100000) == SQLite::TimeSeries::Minute,"An expired raw range should be read from the rollups");
+
+ }};
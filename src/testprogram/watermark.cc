@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2021 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ #include "selftest.h"
+
+ using namespace std;
+ using namespace Udjat;
+ using SelfTest::check;
+ using SelfTest::integer;
+
+ static const char *definition =
+	"<sql name='selftest' table='alerts' acknowledge='watermark'>"
+		"<init>create table if not exists alerts (url text, action text, payload text)</init>"
+		"<insert>insert into alerts (url,action,payload) values (?,?,?)</insert>"
+	"</sql>";
+
+ /// @brief Get the id of the next request to send, 0 if none.
+ static int64_t next(const SQLite::Protocol::Shard &shard) {
+	int64_t id = 0;
+	shard.select->reset();
+	if(shard.select->step() == SQLITE_ROW) {
+		shard.select->get(0,id);
+	}
+	shard.select->reset();
+	return id;
+ }
+
+ /// @brief Out of order acks are kept as exceptions, sent before the rows after the watermark.
+ static SelfTest::Test order{"watermark out of order acknowledge",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition);
+
+	protocol->enqueue({
+		{"http://localhost/1","post","1"},
+		{"http://localhost/2","post","2"},
+		{"http://localhost/3","post","3"},
+		{"http://localhost/4","post","4"}
+	});
+
+	auto shard = protocol->shards[0];
+
+	check(next(shard) == 1,"The first request should be sent first");
+	protocol->acknowledge(shard,{1});
+	check(next(shard) == 2,"The watermark should advance on an in order ack");
+	protocol->acknowledge(shard,{3});
+	check(next(shard) == 2,"A skipped request should be kept as exception");
+	protocol->acknowledge(shard,{2});
+	check(next(shard) == 4,"An acknowledged exception should be removed");
+	check(protocol->count() == 1,"Only one request should be pending");
+
+ }};
+
+ /// @brief Purging must keep new requests above the watermark.
+ static SelfTest::Test purge{"watermark purge",[](){
+
+	auto db = make_shared<SQLite::Database>(":memory:");
+	auto protocol = SelfTest::protocol(db,definition);
+
+	protocol->enqueue({
+		{"http://localhost/1","post","1"},
+		{"http://localhost/2","post","2"},
+		{"http://localhost/3","post","3"}
+	});
+
+	auto shard = protocol->shards[0];
+
+	protocol->acknowledge(shard,{1,2,3});
+	protocol->purge(db,"alerts");
+
+	check(integer(db,"select count(*) from alerts") == 1,"The row on the watermark should be kept by purge");
+
+	protocol->enqueue({{"http://localhost/4","post","4"}});
+
+	check(next(shard) == 4,"A request queued after purge should be the next one sent");
+	check(protocol->count() == 1,"A request queued after purge should be pending");
+
+ }};